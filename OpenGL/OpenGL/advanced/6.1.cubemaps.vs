@@ -6,8 +6,7 @@ out vec3 Normal;
 out vec3 Position;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "../common/frame_data.glsl"
 
 void main()
 {
@@ -0,0 +1,26 @@
+#pragma once
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <cstddef>
+
+// Counts every global operator new of the program, on all threads. allocation_counter.cpp replaces the global
+// allocation functions, so linking it in is all it takes.
+namespace AllocationCounter {
+    size_t allocations();
+    size_t bytes();
+
+    // Counts between construction and the call to allocations().
+    class Scope {
+    public:
+        Scope() : allocations_(AllocationCounter::allocations()), bytes_(AllocationCounter::bytes()) {}
+        size_t allocations() const { return AllocationCounter::allocations() - allocations_; }
+        size_t bytes() const { return AllocationCounter::bytes() - bytes_; }
+
+    private:
+        size_t allocations_;
+        size_t bytes_;
+    };
+}  // namespace AllocationCounter
+
+#endif
@@ -1,11 +1,20 @@
+#include "benchmark.h"
 #include "camera.h"
+#include "frame_uniforms.h"
+#include "gl_state.h"
 #include "glad/glad.h"
+#include "instance_buffer.h"
 #include "model.h"
+#include "render_queue.h"
 #include "shader.h"
+#include "shader_compile_queue.h"
+#include "shader_variants.h"
+#include "texture_cache.h"
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
-#include <map>
 #include <vector>
 
 #define STB_IMAGE_IMPLEMENTATION
@@ -74,7 +83,7 @@ unsigned int bindVertexArrayObject()
     // Vertex array object.
     unsigned int vertex_array_object;
     glGenVertexArrays(1, &vertex_array_object);
-    glBindVertexArray(vertex_array_object);
+    GlState::shared().bindVertexArray(vertex_array_object);
     return vertex_array_object;
 }
 
@@ -88,6 +97,8 @@ unsigned int bindVertexBufferObject(float vertices[], unsigned int vertices_size
     return vertex_buffer_object;
 }
 
+// The element buffer binding belongs to the bound vertex array, so bind the demo's own first (bindVertexArrayObject),
+// not whatever the last draw left, e.g. the GeometryArena's.
 unsigned int bindElementBufferObject(unsigned int indices[], unsigned int indices_size)
 {
     // Element Buffer object.
@@ -98,42 +109,12 @@ unsigned int bindElementBufferObject(unsigned int indices[], unsigned int indice
     return element_buffer_object;
 }
 
+// Textures are shared through the TextureCache, so demos loading the same image decode it once.
 unsigned int generateTexture(const char* image_path, int active_texture, bool flip_vertically = true)
 {
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glActiveTexture(active_texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Flip vertically.
-    stbi_set_flip_vertically_on_load(true);
-
-    // Load texture.
-    int width = 0;
-    int height = 0;
-    int nrChannels = 0;
-    unsigned char* data = stbi_load(image_path, &width, &height, &nrChannels, 0);
-    if (data != nullptr) {
-        int rgb_mode;
-        if (nrChannels == 1)
-            rgb_mode = GL_RED;
-        else if (nrChannels == 3)
-            rgb_mode = GL_RGB;
-        else if (nrChannels == 4)
-            rgb_mode = GL_RGBA;
-
-        glTexImage2D(GL_TEXTURE_2D, 0, rgb_mode, width, height, 0, rgb_mode, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-    } else {
-        std::cout << "Failed to load texture." << std::endl;
-    }
-    // Recycle the image data.
-    stbi_image_free(data);
+    GlState::shared().activeTexture(active_texture);
+    unsigned int texture = TextureCache::instance().load2D(image_path, flip_vertically);
+    GlState::shared().bindTexture(GL_TEXTURE_2D, texture);
     return texture;
 }
 
@@ -233,12 +214,10 @@ namespace GettingStarted {
         glm::mat4 projection(1.0f);
         projection = glm::perspective(glm::radians(45.0f), (float)(640.0 / 480.0), 0.1f, 100.0f);
 
-        int modelLoc = glGetUniformLocation(shader.shader_program, "model");
+        int modelLoc = glGetUniformLocation(shader.id(), "model");
         glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        int viewLoc = glGetUniformLocation(shader.shader_program, "view");
-        glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-        int projectionLoc = glGetUniformLocation(shader.shader_program, "projection");
-        glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+        // The view is fixed, so the frame block only needs filling once. The camera sits 3 units back.
+        FrameUniforms::shared().update(view, projection, glm::vec3(0.0f, 0.0f, 3.0f), 0.0f);
 
         //// Wireframe mode.
         // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -331,7 +310,6 @@ namespace GettingStarted {
 
         glm::mat4 projection(1.0f);
         projection = glm::perspective(glm::radians(60.0f), (float)(640.0 / 480.0), 0.1f, 10.0f);
-        shader.setMat4("projection", projection);
 
         //// Wireframe mode.
         // glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -355,6 +333,8 @@ namespace GettingStarted {
             last_frame = current_frame;
 
             processKeyboard(window);
+            // Camera.
+            camera.updateFrameUniforms(projection, current_frame);
 
             // Draw the triangle.
             shader.use();
@@ -370,10 +350,6 @@ namespace GettingStarted {
                 glDrawArrays(GL_TRIANGLES, 0, 36);
             }
 
-            // Camera.
-            glm::mat4 view = camera.getViewMatrix();
-            shader.setMat4("view", view);
-
             /* Swap front and back buffers */
             glfwSwapBuffers(window);
 
@@ -463,11 +439,12 @@ namespace Lighting {
         // unsigned int emission_texture = generateTexture(
         //     "D:\\Turotials\\StudyOpenGL\\OpenGL\\Assets\\matrix.jpg", GL_TEXTURE2, GL_RGB);
 
-        // Compile.
+        // Compile. Boxes and lamps are each drawn with one instanced call.
+        const ShaderDefines instanced = {{"INSTANCED", "1"}};
         Shader box_shader("D:/Turotials/StudyOpenGL/OpenGL/OpenGL/lighting/box_shader.vs",
-                          "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/lighting/box_shader.fs");
+                          "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/lighting/box_shader.fs", instanced);
         Shader cube_lamp_shader("D:/Turotials/StudyOpenGL/OpenGL/OpenGL/lighting/lamp_shader.vs",
-                                "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/lighting/lamp_shader.fs");
+                                "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/lighting/lamp_shader.fs", instanced);
 
         glm::mat4 projection(1.0f);
         projection = glm::perspective(glm::radians(60.0f), (float)(640.0 / 480.0), 0.1f, 500.0f);
@@ -518,6 +495,27 @@ namespace Lighting {
 
         // Light damping.
 
+        // The instances carry the whole transform.
+        box_shader.setMat4("model", glm::mat4(1.0f));
+        cube_lamp_shader.use();
+        cube_lamp_shader.setMat4("model", glm::mat4(1.0f));
+
+        // The lamps don't move, the boxes are rewritten every frame.
+        InstanceBuffer lamp_instances;
+        std::vector<glm::mat4> lamp_transforms;
+        for (const glm::vec3& position : pointLightPositions) {
+            lamp_transforms.push_back(glm::scale(glm::translate(glm::mat4(1.0f), position), glm::vec3(0.2f)));
+        }
+        lamp_instances.update(lamp_transforms);
+        InstanceBuffer box_instances;
+        std::vector<glm::mat4> box_transforms(10);
+        // Only the boxes inside the view are uploaded.
+        const Culling::Box unit_box = {glm::vec3(0.0f), glm::vec3(0.5f)};
+        Culling::Boxes box_bounds;
+        std::vector<uint32_t> visible_boxes;
+        std::vector<glm::mat4> visible_transforms;
+        Culling::Stats cull_stats;
+
         /* Loop until the user closes the window */
         while (!glfwWindowShouldClose(window)) {
             /* Render here */
@@ -543,20 +541,15 @@ namespace Lighting {
             // glm::vec3 diffuseColor = lightColor * glm::vec3(0.5f);    // Ӱ
             // glm::vec3 ambientColor = diffuseColor * glm::vec3(0.2f);  // ܵ͵Ӱ
 
-            // Camera.
-            glm::mat4 view = camera.getViewMatrix();
-            glm::mat4 model(1.0f);
+            // Camera, shared by both shaders through the frame block.
+            camera.updateFrameUniforms(projection, current_frame);
             // Use the box shader.
             box_shader.use();
             // Set coordinates.
             // box_shader.setMat4("model", model);
-            box_shader.setMat4("projection", projection);
             // Set materials.
             box_shader.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
             box_shader.setFloat("material.shininess", 64.0f);
-            // Set the view matrix.
-            box_shader.setMat4("view", view);
-            box_shader.setVec3("viewPos", camera.position_);
 
             // Set spot light coordinates.
             box_shader.setVec3("spotLight.basic.position", camera.position_);
@@ -569,27 +562,27 @@ namespace Lighting {
                 float angle = 20.0f * i;
                 model = glm::rotate(model, glm::radians(angle), glm::vec3(1.0f, 0.3f, 0.5f));
                 model = glm::rotate(model, (float)glfwGetTime() * glm::radians(20.0f), glm::vec3(0.5f, 1.0f, 0.0f));
-                box_shader.setMat4("model", model);
-                // Draw the box.
-                glBindVertexArray(box_vao);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
+                box_transforms[i] = model;
             }
+            box_bounds.clear();
+            for (const glm::mat4& transform : box_transforms) {
+                box_bounds.add(unit_box, transform);
+            }
+            size_t visible = Culling::cullBoxes(camera.getFrustum(projection), box_bounds, visible_boxes);
+            cull_stats.objects += box_bounds.size();
+            cull_stats.objects_culled += box_bounds.size() - visible;
+            visible_transforms.clear();
+            for (uint32_t index : visible_boxes) {
+                visible_transforms.push_back(box_transforms[index]);
+            }
+            box_instances.update(visible_transforms);
+            // Draw the boxes.
+            box_instances.draw(box_vao, 36);
 
             // Use the lamp shader.
             cube_lamp_shader.use();
-            // Set the view matrix.
-            cube_lamp_shader.setMat4("view", view);
-            // Set the projection matrix.
-            cube_lamp_shader.setMat4("projection", projection);
-            for (int i = 0; i < 4; ++i) {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, pointLightPositions[i]);
-                model = glm::scale(model, glm::vec3(0.2f));
-                cube_lamp_shader.setMat4("model", model);
-                // Draw the lamp.
-                glBindVertexArray(light_vao);
-                glDrawArrays(GL_TRIANGLES, 0, 36);
-            }
+            // Draw the lamps.
+            lamp_instances.draw(light_vao, 36);
 
             /* Swap front and back buffers */
             glfwSwapBuffers(window);
@@ -597,6 +590,8 @@ namespace Lighting {
             /* Poll for and process events */
             glfwPollEvents();
         }
+        std::cout << "Frustum culling: " << cull_stats.objects_culled << " of " << cull_stats.objects
+                  << " boxes culled" << std::endl;
 
         // Optianl, de-allocate all resource once ther've outlived their purpose.
         glDeleteVertexArrays(1, &box_vao);
@@ -617,6 +612,12 @@ namespace BasicModel {
 
         // Model.
         Model modeler("D:/Turotials/StudyOpenGL/OpenGL/Assets/nanosuit.obj");
+        // Its meshes are queued every frame and drawn sorted by program and material, nearest first. The ones outside
+        // the view aren't queued at all.
+        RenderQueue queue;
+        RenderQueue::Item model_item;
+        model_item.shader = &modelShader;
+        Culling::Stats cull_stats;
 
         glEnable(GL_DEPTH_TEST);
         // Capture the mouse in the window.
@@ -638,12 +639,9 @@ namespace BasicModel {
 
             processKeyboard(window);
 
-            modelShader.use();
             // view/projection transformations
             glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_), 640.0f / 480.0f, 0.1f, 100.0f);
-            glm::mat4 view = camera.getViewMatrix();
-            modelShader.setMat4("projection", projection);
-            modelShader.setMat4("view", view);
+            camera.updateFrameUniforms(projection, current_frame);
 
             // render the loaded model
             glm::mat4 model = glm::mat4(1.0f);
@@ -651,8 +649,76 @@ namespace BasicModel {
                 model, glm::vec3(0.0f, 0.0f, 0.0f));             // translate it down so it's at the center of the scene
             model =
                 glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));  // it's a bit too big for our scene, so scale it down
-            modelShader.setMat4("model", model);
-            modeler.draw(modelShader);
+            queue.begin(camera.position_);
+            modeler.submit(queue, model_item, model, camera.getFrustum(projection), cull_stats);
+            queue.submit();
+
+            /* Swap front and back buffers */
+            glfwSwapBuffers(window);
+
+            /* Poll for and process events */
+            glfwPollEvents();
+        }
+        std::cout << "Frustum culling: " << cull_stats.objects_culled << " of " << cull_stats.objects
+                  << " mesh instances culled" << std::endl;
+    }
+
+    // Same scene, but the model streams in while the loop keeps rendering.
+    void drawModelStreaming(GLFWwindow* window)
+    {
+        // Shader, compiled by the driver while the model loads.
+        ShaderCompileQueue shaders;
+        Shader& modelShader = shaders.submit("D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/model.vs",
+                                             "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/model.fs");
+
+        // Spread the uploads over frames and log each texture and mesh as it becomes resident.
+        UploadQueue::main().setBudget(8 << 20, 2.0);
+        UploadQueue::main().setResidencyListener([](const std::string& label, size_t bytes, size_t frame) {
+            std::cout << "Resident at frame " << frame << ": " << label << " (" << bytes / 1024 << " KiB)" << std::endl;
+        });
+
+        // Model, parsed and decoded on the worker pool.
+        std::future<std::unique_ptr<Model>> pending =
+            Model::loadAsync("D:/Turotials/StudyOpenGL/OpenGL/Assets/nanosuit.obj");
+        std::unique_ptr<Model> modeler;
+        float load_start = glfwGetTime();
+
+        glEnable(GL_DEPTH_TEST);
+        // Capture the mouse in the window.
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+        // Set call back function to process mouse movement.
+        glfwSetCursorPosCallback(window, processMouseMovement);
+        // Set call back function to process mouse scroll.
+        glfwSetScrollCallback(window, processMouseScroll);
+
+        /* Loop until the user closes the window */
+        while (!glfwWindowShouldClose(window)) {
+            // Run the GL work the loader posted, then pick the model up once it's complete.
+            UploadQueue::main().process();
+            shaders.process();
+            if (pending.valid() && pending.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                modeler = pending.get();
+                std::cout << "Model streamed in " << (glfwGetTime() - load_start) * 1000.0 << " ms" << std::endl;
+            }
+
+            /* Render here */
+            glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+            float current_frame = glfwGetTime();
+            delta_time = current_frame - last_frame;
+            last_frame = current_frame;
+
+            processKeyboard(window);
+
+            // Nothing to draw until both the model and its program are ready.
+            if (modeler && modelShader.ready()) {
+                modelShader.use();
+                // view/projection transformations
+                glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_), 640.0f / 480.0f, 0.1f, 100.0f);
+                camera.updateFrameUniforms(projection, current_frame);
+                modeler->draw(modelShader);
+            }
 
             /* Swap front and back buffers */
             glfwSwapBuffers(window);
@@ -669,10 +735,6 @@ namespace BasicModel {
         // Flip y-axis of loaded texture.
         stbi_set_flip_vertically_on_load(true);
 
-        // Shader.
-        Shader model_shader("D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/model_shader.vs",
-                            "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/model_shader.fs");
-
         // Model.
         Model modeler("D:/Turotials/StudyOpenGL/OpenGL/Assets/nanosuit.obj");
 
@@ -731,41 +793,46 @@ namespace BasicModel {
         // Set call back function to process mouse scroll.
         glfwSetScrollCallback(window, processMouseScroll);
 
-        // Use the box shader.
-        model_shader.use();
-        // Set textures.
-        model_shader.setInt("material.diffuse", 0);
-        model_shader.setInt("material.specular", 1);
-        // box_shader.setInt("material.emission", 2);
-
-        // Direction light.
-        model_shader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
-        model_shader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
-        model_shader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
-        model_shader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
-        // Point lights.
-        for (int i = 0; i < 4; ++i) {
-            std::string pointLightName = std::string("pointLights[") + (char)(i + '0') + ']';
-            model_shader.setVec3(pointLightName + ".position", pointLightPositions[i]);
-
-            model_shader.setVec3(pointLightName + ".ambient", 0.2f, 0.2f, 0.2f);
-            model_shader.setVec3(pointLightName + ".diffuse", 0.5f, 0.5f, 0.5f);
-            model_shader.setVec3(pointLightName + ".specular", 1.0f, 1.0f, 1.0f);
-
-            model_shader.setFloat(pointLightName + ".conatant", 1.0f);
-            model_shader.setFloat(pointLightName + ".linear", 0.09f);
-            model_shader.setFloat(pointLightName + ".quadratic", 0.032f);
-        }
-        // Spot light.
-        model_shader.setVec3("spotLight.basic.ambient", 0.0f, 0.0f, 0.0f);
-        model_shader.setVec3("spotLight.basic.diffuse", 1.0f, 1.0f, 1.0f);
-        model_shader.setVec3("spotLight.basic.specular", 1.0f, 1.0f, 1.0f);
-        model_shader.setFloat("spotLight.basic.constant", 1.0f);
-        model_shader.setFloat("spotLight.basic.linear", 0.09f);
-        model_shader.setFloat("spotLight.basic.quadratic", 0.032f);
-
-        model_shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
-        model_shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+        // Shader variants, one per set of defines. The uniforms that never change are set once per variant.
+        const ShaderDefines light_defines = {{"DIR_LIGHT", "1"}, {"NR_POINT_LIGHTS", "4"}, {"SPOT_LIGHT", "1"}};
+        ShaderVariants model_variants(
+            "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/model_shader.vs",
+            "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/model_shader.fs",
+            [&pointLightPositions](Shader& shader, const ShaderDefines&) {
+                // Set textures.
+                shader.setInt("material.diffuse", 0);
+                shader.setInt("material.specular", 1);
+                // box_shader.setInt("material.emission", 2);
+
+                // Direction light.
+                shader.setVec3("dirLight.direction", -0.2f, -1.0f, -0.3f);
+                shader.setVec3("dirLight.ambient", 0.05f, 0.05f, 0.05f);
+                shader.setVec3("dirLight.diffuse", 0.4f, 0.4f, 0.4f);
+                shader.setVec3("dirLight.specular", 0.5f, 0.5f, 0.5f);
+                // Point lights.
+                for (int i = 0; i < 4; ++i) {
+                    std::string pointLightName = std::string("pointLights[") + (char)(i + '0') + ']';
+                    shader.setVec3(pointLightName + ".position", pointLightPositions[i]);
+
+                    shader.setVec3(pointLightName + ".ambient", 0.2f, 0.2f, 0.2f);
+                    shader.setVec3(pointLightName + ".diffuse", 0.5f, 0.5f, 0.5f);
+                    shader.setVec3(pointLightName + ".specular", 1.0f, 1.0f, 1.0f);
+
+                    shader.setFloat(pointLightName + ".conatant", 1.0f);
+                    shader.setFloat(pointLightName + ".linear", 0.09f);
+                    shader.setFloat(pointLightName + ".quadratic", 0.032f);
+                }
+                // Spot light.
+                shader.setVec3("spotLight.basic.ambient", 0.0f, 0.0f, 0.0f);
+                shader.setVec3("spotLight.basic.diffuse", 1.0f, 1.0f, 1.0f);
+                shader.setVec3("spotLight.basic.specular", 1.0f, 1.0f, 1.0f);
+                shader.setFloat("spotLight.basic.constant", 1.0f);
+                shader.setFloat("spotLight.basic.linear", 0.09f);
+                shader.setFloat("spotLight.basic.quadratic", 0.032f);
+
+                shader.setFloat("spotLight.cutOff", glm::cos(glm::radians(12.5f)));
+                shader.setFloat("spotLight.outerCutOff", glm::cos(glm::radians(15.0f)));
+            });
 
         //// Light damping.
 
@@ -780,44 +847,34 @@ namespace BasicModel {
             last_frame = current_frame;
 
             processKeyboard(window);
-            // Camera.
-            glm::mat4 view = camera.getViewMatrix();
+            // Camera, shared by both shaders through the frame block.
             glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_), 640.0f / 480.0f, 0.1f, 100.0f);
+            camera.updateFrameUniforms(projection, current_frame);
             glm::mat4 model(1.0f);
-            // Use the box shader.
-            model_shader.use();
             model = glm::translate(
                 model, glm::vec3(0.0f, 0.0f, 0.0f));             // translate it down so it's at the center of the scene
             model =
                 glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));  // it's a bit too big for our scene, so scale it down
-            model_shader.setMat4("model", model);
-            model_shader.setMat4("model", model);
-            model_shader.setMat4("projection", projection);
-            // Set materials.
-            model_shader.setVec3("material.specular", 0.5f, 0.5f, 0.5f);
-            model_shader.setFloat("material.shininess", 64.0f);
-            // Set the view matrix.
-            model_shader.setMat4("view", view);
-            model_shader.setVec3("viewPos", camera.position_);
+            // Meshes without a specular map are drawn by the variant using a constant specular colour.
+            modeler.draw(model_variants, light_defines, model, [](Shader& shader) {
+                // Set materials.
+                shader.setVec3("material.specularColor", 0.5f, 0.5f, 0.5f);
+                shader.setFloat("material.shininess", 64.0f);
 
-            // Set spot light coordinates.
-            model_shader.setVec3("spotLight.basic.position", camera.position_);
-            model_shader.setVec3("spotLight.direction", camera.front_);
-            modeler.draw(model_shader);
+                // Set spot light coordinates.
+                shader.setVec3("spotLight.basic.position", camera.position_);
+                shader.setVec3("spotLight.direction", camera.front_);
+            });
 
             // Use the lamp shader.
             cube_lamp_shader.use();
-            // Set the view matrix.
-            cube_lamp_shader.setMat4("view", view);
-            // Set the projection matrix.
-            cube_lamp_shader.setMat4("projection", projection);
             for (int i = 0; i < 4; ++i) {
                 model = glm::mat4(1.0f);
                 model = glm::translate(model, pointLightPositions[i]);
                 model = glm::scale(model, glm::vec3(0.2f));
                 cube_lamp_shader.setMat4("model", model);
                 // Draw the lamp.
-                glBindVertexArray(light_vao);
+                GlState::shared().bindVertexArray(light_vao);
                 glDrawArrays(GL_TRIANGLES, 0, 36);
             }
 
@@ -895,8 +952,7 @@ namespace Advanced {
         //        scene
         //    model =
         //        glm::scale(model, glm::vec3(1.0f, 1.0f, 1.0f));  // it's a bit too big for our scene, so scale it down
-        //    modelShader.setMat4("model", model);
-        //    modeler.draw(modelShader);
+        //    modeler.draw(modelShader, model);
 
         //    // Draw the model again, but scale slightly.
         //    glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
@@ -914,8 +970,7 @@ namespace Advanced {
         //        scene
         //    model = glm::scale(model,
         //                       glm::vec3(scale, scale, scale));  // Scale a little bigger.
-        //    singleColorShader.setMat4("model", model);
-        //    modeler.draw(singleColorShader);
+        //    modeler.draw(singleColorShader, model);
 
         //    glStencilMask(0xFF);
         //    glStencilFunc(GL_ALWAYS, 0, 0xFF);
@@ -937,13 +992,23 @@ namespace Advanced {
         // Set call back function to process mouse scroll.
         glfwSetScrollCallback(window, processMouseScroll);
 
-        // configure global opengl state
+        // pipeline states of the two passes, applied per pass by diffing against the current state
         // -----------------------------
-        glEnable(GL_DEPTH_TEST);
-        glDepthFunc(GL_LESS);
-        glEnable(GL_STENCIL_TEST);
-        glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-        glStencilOp(GL_KEEP, GL_KEEP, GL_REPLACE);
+        // Objects write 1 to the stencil buffer wherever they pass the depth test.
+        PipelineState::Desc objects_desc;
+        objects_desc.depth.test = true;
+        objects_desc.depth.func = GL_LESS;
+        objects_desc.stencil.test = true;
+        objects_desc.stencil.func = GL_ALWAYS;
+        objects_desc.stencil.ref = 1;
+        objects_desc.stencil.depth_pass = GL_REPLACE;
+        const PipelineState objects(objects_desc);
+        // Outlines are drawn where the stencil isn't 1, over everything, and leave the stencil buffer alone.
+        PipelineState::Desc outline_desc = objects_desc;
+        outline_desc.depth.test = false;
+        outline_desc.stencil.func = GL_NOTEQUAL;
+        outline_desc.stencil.write_mask = 0x00;
+        const PipelineState outline(outline_desc);
 
         // build and compile shaders
         // -------------------------
@@ -983,26 +1048,26 @@ namespace Advanced {
         unsigned int cubeVAO, cubeVBO;
         glGenVertexArrays(1, &cubeVAO);
         glGenBuffers(1, &cubeVBO);
-        glBindVertexArray(cubeVAO);
+        GlState::shared().bindVertexArray(cubeVAO);
         glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glBindVertexArray(0);
+        GlState::shared().bindVertexArray(0);
         // plane VAO
         unsigned int planeVAO, planeVBO;
         glGenVertexArrays(1, &planeVAO);
         glGenBuffers(1, &planeVBO);
-        glBindVertexArray(planeVAO);
+        GlState::shared().bindVertexArray(planeVAO);
         glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glBindVertexArray(0);
+        GlState::shared().bindVertexArray(0);
 
         // load textures
         // -------------
@@ -1029,6 +1094,8 @@ namespace Advanced {
 
             // render
             // ------
+            // The objects' state comes first, glClear honours its depth and stencil write masks.
+            GlState::shared().apply(objects);
             glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT |
                     GL_STENCIL_BUFFER_BIT);  // don't forget to clear the stencil buffer!
@@ -1036,14 +1103,11 @@ namespace Advanced {
             // set uniforms
             shaderSingleColor.use();
             glm::mat4 model = glm::mat4(1.0f);
-            glm::mat4 view = camera.getViewMatrix();
             glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_), 640.0f / 480.f, 0.1f, 100.0f);
-            shaderSingleColor.setMat4("view", view);
-            shaderSingleColor.setMat4("projection", projection);
+            // Both shaders read the camera from the frame block.
+            camera.updateFrameUniforms(projection, current_frame);
 
             shader.use();
-            shader.setMat4("view", view);
-            shader.setMat4("projection", projection);
 
             //// draw floor as normal, but don't write the floor to the stencil buffer, we only care about the
             /// containers. / We set its mask to 0x00 to not write to the stencil buffer.
@@ -1057,12 +1121,10 @@ namespace Advanced {
 
             // 1st. render pass, draw objects as normal, writing to the stencil buffer
             // --------------------------------------------------------------------
-            glStencilFunc(GL_ALWAYS, 1, 0xFF);
-            glStencilMask(0xFF);
             // cubes
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, cubeTexture);
+            GlState::shared().bindVertexArray(cubeVAO);
+            GlState::shared().activeTexture(GL_TEXTURE0);
+            GlState::shared().bindTexture(GL_TEXTURE_2D, cubeTexture);
             model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
             shader.setMat4("model", model);
             glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -1075,14 +1137,12 @@ namespace Advanced {
             // Because the stencil buffer is now filled with several 1s. The parts of the buffer that are 1 are not
             // drawn, thus only drawing the objects' size differences, making it look like borders.
             // -----------------------------------------------------------------------------------------------------------------------------
-            glStencilFunc(GL_NOTEQUAL, 1, 0xFF);
-            glStencilMask(0x00);
-            glDisable(GL_DEPTH_TEST);
+            GlState::shared().apply(outline);
             shaderSingleColor.use();
             float scale = 1.1f;
             // cubes
-            glBindVertexArray(cubeVAO);
-            glBindTexture(GL_TEXTURE_2D, cubeTexture);
+            GlState::shared().bindVertexArray(cubeVAO);
+            GlState::shared().bindTexture(GL_TEXTURE_2D, cubeTexture);
             model = glm::mat4(1.0f);
             model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
             model = glm::scale(model, glm::vec3(scale, scale, scale));
@@ -1093,10 +1153,7 @@ namespace Advanced {
             model = glm::scale(model, glm::vec3(scale, scale, scale));
             shaderSingleColor.setMat4("model", model);
             glDrawArrays(GL_TRIANGLES, 0, 36);
-            glBindVertexArray(0);
-            glStencilMask(0xFF);
-            glStencilFunc(GL_ALWAYS, 0, 0xFF);
-            glEnable(GL_DEPTH_TEST);
+            GlState::shared().endFrame();
 
             // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
             // -------------------------------------------------------------------------------
@@ -1117,10 +1174,19 @@ namespace Advanced {
         // Shader.
         Shader shader("D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/3.2.blending.vs",
                       "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/3.2.blending.fs");
-
-        glEnable(GL_DEPTH_TEST);
-        glEnable(GL_BLEND);
-        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        // The windows are one instanced draw.
+        Shader window_shader("D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/3.2.blending.vs",
+                             "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/model/3.2.blending.fs", {{"INSTANCED", "1"}});
+
+        // Only the windows blend, the render queue draws them after everything opaque.
+        PipelineState::Desc opaque_desc;
+        opaque_desc.depth.test = true;
+        const PipelineState opaque(opaque_desc);
+        PipelineState::Desc transparent_desc = opaque_desc;
+        transparent_desc.blend.enabled = true;
+        transparent_desc.blend.src = GL_SRC_ALPHA;
+        transparent_desc.blend.dst = GL_ONE_MINUS_SRC_ALPHA;
+        const PipelineState transparent(transparent_desc);
         //glEnable(GL_CULL_FACE);
         //glCullFace(GL_BACK);
 
@@ -1191,7 +1257,7 @@ namespace Advanced {
         unsigned int cubeVAO, cubeVBO;
         glGenVertexArrays(1, &cubeVAO);
         glGenBuffers(1, &cubeVBO);
-        glBindVertexArray(cubeVAO);
+        GlState::shared().bindVertexArray(cubeVAO);
         glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(cubeVertices), &cubeVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1202,7 +1268,7 @@ namespace Advanced {
         unsigned int planeVAO, planeVBO;
         glGenVertexArrays(1, &planeVAO);
         glGenBuffers(1, &planeVBO);
-        glBindVertexArray(planeVAO);
+        GlState::shared().bindVertexArray(planeVAO);
         glBindBuffer(GL_ARRAY_BUFFER, planeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(planeVertices), &planeVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1213,14 +1279,14 @@ namespace Advanced {
         unsigned int transparentVAO, transparentVBO;
         glGenVertexArrays(1, &transparentVAO);
         glGenBuffers(1, &transparentVBO);
-        glBindVertexArray(transparentVAO);
+        GlState::shared().bindVertexArray(transparentVAO);
         glBindBuffer(GL_ARRAY_BUFFER, transparentVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(transparentVertices), transparentVertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
         glEnableVertexAttribArray(1);
         glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)(3 * sizeof(float)));
-        glBindVertexArray(0);
+        GlState::shared().bindVertexArray(0);
 
         // load textures
         // -------------
@@ -1239,6 +1305,11 @@ namespace Advanced {
         // --------------------
         shader.use();
         shader.setInt("texture1", 0);
+        window_shader.use();
+        window_shader.setInt("texture1", 0);
+        RenderQueue queue;
+        InstanceBuffer window_instances;
+        std::vector<glm::mat4> window_transforms;
 
         /* Loop until the user closes the window */
         while (!glfwWindowShouldClose(window)) {
@@ -1252,52 +1323,58 @@ namespace Advanced {
 
             processKeyboard(window);
 
-            // sort the transparent windows before rendering
-            // ---------------------------------------------
-            std::map<float, glm::vec3> sorted;
-            for (unsigned int i = 0; i < windows.size(); i++) {
-                float distance = glm::length(camera.position_ - windows[i]);
-                sorted[distance] = windows[i];
-            }
-
             // render
             // ------
             glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             // draw objects
-            shader.use();
             glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_), 640.0f / 480.0f, 0.1f, 100.0f);
-            glm::mat4 view = camera.getViewMatrix();
-            glm::mat4 model = glm::mat4(1.0f);
-            shader.setMat4("projection", projection);
-            shader.setMat4("view", view);
+            camera.updateFrameUniforms(projection, current_frame);
+            queue.begin(camera.position_);
             // cubes
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, cubeTexture);
-            model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
-            shader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
-            model = glm::mat4(1.0f);
-            model = glm::translate(model, glm::vec3(2.0f, 0.0f, 0.0f));
-            shader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 36);
+            RenderQueue::Item cube;
+            cube.pipeline = &opaque;
+            cube.shader = &shader;
+            cube.material = static_cast<uint16_t>(cubeTexture);
+            cube.vertex_array = cubeVAO;
+            cube.texture = cubeTexture;
+            cube.vertex_count = 36;
+            for (const glm::vec3& position : {glm::vec3(-1.0f, 0.0f, -1.0f), glm::vec3(2.0f, 0.0f, 0.0f)}) {
+                cube.transform = glm::translate(glm::mat4(1.0f), position);
+                cube.depth = queue.depthOf(position);
+                queue.add(cube);
+            }
             // floor
-            glBindVertexArray(planeVAO);
-            glBindTexture(GL_TEXTURE_2D, floorTexture);
-            model = glm::mat4(1.0f);
-            shader.setMat4("model", model);
-            glDrawArrays(GL_TRIANGLES, 0, 6);
-            // windows (from furthest to nearest)
-            glBindVertexArray(transparentVAO);
-            glBindTexture(GL_TEXTURE_2D, transparentTexture);
-            for (std::map<float, glm::vec3>::reverse_iterator it = sorted.rbegin(); it != sorted.rend(); ++it) {
-                model = glm::mat4(1.0f);
-                model = glm::translate(model, it->second);
-                shader.setMat4("model", model);
-                glDrawArrays(GL_TRIANGLES, 0, 6);
+            RenderQueue::Item floor = cube;
+            floor.material = static_cast<uint16_t>(floorTexture);
+            floor.vertex_array = planeVAO;
+            floor.texture = floorTexture;
+            floor.vertex_count = 6;
+            floor.transform = glm::mat4(1.0f);
+            floor.depth = queue.depthOf(glm::vec3(0.0f));
+            queue.add(floor);
+            // windows, instances are drawn in buffer order so they go in from furthest to nearest
+            std::sort(windows.begin(), windows.end(), [&](const glm::vec3& a, const glm::vec3& b) {
+                return queue.depthOf(a) > queue.depthOf(b);
+            });
+            window_transforms.clear();
+            for (const glm::vec3& position : windows) {
+                window_transforms.push_back(glm::translate(glm::mat4(1.0f), position));
             }
+            window_instances.update(window_transforms);
+            RenderQueue::Item window_item = floor;
+            window_item.transparent = true;
+            window_item.pipeline = &transparent;
+            window_item.shader = &window_shader;
+            window_item.material = static_cast<uint16_t>(transparentTexture);
+            window_item.vertex_array = transparentVAO;
+            window_item.texture = transparentTexture;
+            window_item.depth = queue.depthOf(windows.front());
+            window_item.instances = &window_instances;
+            queue.add(window_item);
+            queue.submit();
+            GlState::shared().endFrame();
 
             /* Swap front and back buffers */
             glfwSwapBuffers(window);
@@ -1316,7 +1393,11 @@ namespace Advanced {
 
     void drawExampleWithFramebuffer(GLFWwindow* window)
     {
-        glEnable(GL_DEPTH_TEST);
+        // The scene is depth tested, the screen quad isn't.
+        PipelineState::Desc scene_desc;
+        scene_desc.depth.test = true;
+        const PipelineState scene(scene_desc);
+        const PipelineState screen_quad{PipelineState::Desc()};
 
         Shader shader("D:/Turotials/StudyOpenGL/OpenGL/OpenGL/advanced/5.1.framebuffers.vs",
                       "D:/Turotials/StudyOpenGL/OpenGL/OpenGL/advanced/5.1.framebuffers.fs");
@@ -1403,7 +1484,7 @@ namespace Advanced {
         unsigned int cube_vbo = 0;
         glGenVertexArrays(1, &cube_vao);
         glGenBuffers(1, &cube_vbo);
-        glBindVertexArray(cube_vao);
+        GlState::shared().bindVertexArray(cube_vao);
         glBindBuffer(GL_ARRAY_BUFFER, cube_vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), &cube_vertices, GL_STATIC_DRAW);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -1416,7 +1497,7 @@ namespace Advanced {
         unsigned int plane_vbo = 0;
         glGenVertexArrays(1, &plane_vao);
         glGenBuffers(1, &plane_vbo);
-        glBindVertexArray(plane_vao);
+        GlState::shared().bindVertexArray(plane_vao);
         glBindBuffer(GL_ARRAY_BUFFER, plane_vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(plane_vertices), &plane_vertices, GL_STATIC_DRAW);
         glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 5 * sizeof(float), (void*)0);
@@ -1428,7 +1509,7 @@ namespace Advanced {
         unsigned int quad_vao, quad_vbo;
         glGenVertexArrays(1, &quad_vao);
         glGenBuffers(1, &quad_vbo);
-        glBindVertexArray(quad_vao);
+        GlState::shared().bindVertexArray(quad_vao);
         glBindBuffer(GL_ARRAY_BUFFER, quad_vbo);
         glBufferData(GL_ARRAY_BUFFER, sizeof(quad_vertices), &quad_vertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1455,7 +1536,7 @@ namespace Advanced {
 
         unsigned int texture_color_buffer = 0;
         glGenTextures(1, &texture_color_buffer);
-        glBindTexture(GL_TEXTURE_2D, texture_color_buffer);
+        GlState::shared().bindTexture(GL_TEXTURE_2D, texture_color_buffer);
         glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 640, 480, 0, GL_RGB, GL_UNSIGNED_BYTE, NULL);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
@@ -1481,7 +1562,7 @@ namespace Advanced {
 
             // Bind framebuffer.
             glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
-            glEnable(GL_DEPTH_TEST);
+            GlState::shared().apply(scene);
 
             // Clear framebuffer's content.
             glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
@@ -1489,16 +1570,13 @@ namespace Advanced {
 
             shader.use();
             glm::mat4 model = glm::mat4(1.0f);
-            glm::mat4 view = camera.getViewMatrix();
             glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_), 640.0f / 480.0f, 0.1f, 100.0f);
-
-            shader.setMat4("view", view);
-            shader.setMat4("projection", projection);
+            camera.updateFrameUniforms(projection, current_frame);
 
             // Cubes
-            glBindVertexArray(cube_vao);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, cube_texture);
+            GlState::shared().bindVertexArray(cube_vao);
+            GlState::shared().activeTexture(GL_TEXTURE0);
+            GlState::shared().bindTexture(GL_TEXTURE_2D, cube_texture);
             model = glm::translate(model, glm::vec3(-1.0f, 0.0f, -1.0f));
             shader.setMat4("model", model);
             glDrawArrays(GL_TRIANGLES, 0, 36);
@@ -1508,23 +1586,23 @@ namespace Advanced {
             glDrawArrays(GL_TRIANGLES, 0, 36);
 
             // Floor
-            glBindVertexArray(plane_vao);
-            glBindTexture(GL_TEXTURE_2D, floor_texture);
+            GlState::shared().bindVertexArray(plane_vao);
+            GlState::shared().bindTexture(GL_TEXTURE_2D, floor_texture);
             shader.setMat4("model", glm::mat4(1.0f));
             glDrawArrays(GL_TRIANGLES, 0, 6);
-            glBindVertexArray(0);
 
             // Bind back to default framebuffer and draw quad plane.
             glBindFramebuffer(GL_FRAMEBUFFER, 0);
             // Only one quad and no need depth test.
-            glDisable(GL_DEPTH_TEST);
+            GlState::shared().apply(screen_quad);
             glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
             glClear(GL_COLOR_BUFFER_BIT);
 
             screen_shader.use();
-            glBindVertexArray(quad_vao);
-            glBindTexture(GL_TEXTURE_2D, texture_color_buffer);
+            GlState::shared().bindVertexArray(quad_vao);
+            GlState::shared().bindTexture(GL_TEXTURE_2D, texture_color_buffer);
             glDrawArrays(GL_TRIANGLES, 0, 6);
+            GlState::shared().endFrame();
 
             glfwSwapBuffers(window);
             glfwPollEvents();
@@ -1542,49 +1620,22 @@ namespace Advanced {
         glDeleteFramebuffers(1, &framebuffer);
     }
 
-    unsigned int loadCubemap(vector<std::string> faces)
+    unsigned int loadCubemap(const vector<std::string>& faces)
     {
-        unsigned int texture_id = 0;
-        glGenTextures(1, &texture_id);
-        glBindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
-
-        stbi_set_flip_vertically_on_load(false);
-
-        int width, height, nrChannels;
-        for (unsigned int i = 0; i < faces.size(); i++) {
-            unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-
-            GLenum rgb_mode;
-            if (nrChannels == 1) {
-                rgb_mode = GL_RED;
-            } else if (nrChannels == 3) {
-                rgb_mode = GL_RGB;
-            } else if (nrChannels == 4) {
-                rgb_mode = GL_RGBA;
-            }
-
-            if (data) {
-                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, rgb_mode, width, height, 0, rgb_mode,
-                             GL_UNSIGNED_BYTE, data);
-            } else {
-                std::cout << "Cubemap texture failed to load at path: " << faces[i] << std::endl;
-            }
-
-            stbi_image_free(data);
-        }
-
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
-
+        unsigned int texture_id = TextureCache::instance().loadCubemap(faces);
+        GlState::shared().bindTexture(GL_TEXTURE_CUBE_MAP, texture_id);
         return texture_id;
     }
 
     void skyboxExample(GLFWwindow* window)
     {
-        glEnable(GL_DEPTH_TEST);
+        // The skybox is drawn last at the far plane, so it needs LEQUAL to pass where nothing else was drawn.
+        PipelineState::Desc scene_desc;
+        scene_desc.depth.test = true;
+        const PipelineState scene(scene_desc);
+        PipelineState::Desc skybox_desc = scene_desc;
+        skybox_desc.depth.func = GL_LEQUAL;
+        const PipelineState skybox(skybox_desc);
 
         Shader shader(
             (root_path + "/OpenGL/advanced/6.1.cubemaps.vs").c_str(),
@@ -1671,7 +1722,7 @@ namespace Advanced {
         unsigned int cubeVAO, cubeVBO;
         glGenVertexArrays(1, &cubeVAO);
         glGenBuffers(1, &cubeVBO);
-        glBindVertexArray(cubeVAO);
+        GlState::shared().bindVertexArray(cubeVAO);
         glBindBuffer(GL_ARRAY_BUFFER, cubeVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(cube_vertices), &cube_vertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1682,7 +1733,7 @@ namespace Advanced {
         unsigned int skyboxVAO, skyboxVBO;
         glGenVertexArrays(1, &skyboxVAO);
         glGenBuffers(1, &skyboxVBO);
-        glBindVertexArray(skyboxVAO);
+        GlState::shared().bindVertexArray(skyboxVAO);
         glBindBuffer(GL_ARRAY_BUFFER, skyboxVBO);
         glBufferData(GL_ARRAY_BUFFER, sizeof(skybox_vertices), &skybox_vertices, GL_STATIC_DRAW);
         glEnableVertexAttribArray(0);
@@ -1723,36 +1774,28 @@ namespace Advanced {
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
             // draw scene as normal
+            GlState::shared().apply(scene);
             shader.use();
             glm::mat4 model = glm::mat4(1.0f);
-            glm::mat4 view = camera.getViewMatrix();
             glm::mat4 projection = glm::perspective(glm::radians(camera.zoom_), 640.0f / 480.0f, 0.1f, 100.0f); 
+            camera.updateFrameUniforms(projection, current_frame);
             shader.setMat4("model", model);
-            shader.setMat4("view", view);
-            shader.setMat4("projection", projection);
-            shader.setVec3("cameraPos", camera.position_);
             // cubes
-            glBindVertexArray(cubeVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, cube_texture);
+            GlState::shared().bindVertexArray(cubeVAO);
+            GlState::shared().activeTexture(GL_TEXTURE0);
+            GlState::shared().bindTexture(GL_TEXTURE_2D, cube_texture);
             glDrawArrays(GL_TRIANGLES, 0, 36);
-            glBindVertexArray(0);
 
             // Avoid depth test to let the skybox always behind other things.
-            glDepthFunc(GL_LEQUAL);
+            GlState::shared().apply(skybox);
+            // The skybox shader drops the translation of the view itself.
             skybox_shader.use();
-            model = glm::mat4(1.0f);
-            view = glm::mat4(glm::mat3(camera.getViewMatrix()));
-            projection = glm::perspective(
-                glm::radians(camera.zoom_), 640.0f / 480.0f, 0.1f, 100.0f);
-            skybox_shader.setMat4("view", view);
-            skybox_shader.setMat4("projection", projection);
             // skybox
-            glBindVertexArray(skyboxVAO);
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture);
+            GlState::shared().bindVertexArray(skyboxVAO);
+            GlState::shared().activeTexture(GL_TEXTURE0);
+            GlState::shared().bindTexture(GL_TEXTURE_CUBE_MAP, cubemap_texture);
             glDrawArrays(GL_TRIANGLES, 0, 36);
-            glDepthFunc(GL_LESS);
+            GlState::shared().endFrame();
 
             // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
             // -------------------------------------------------------------------------------
@@ -1802,9 +1845,30 @@ int main(void)
     // Lighting::drawBox(window);
     // BasicModel::drawModel(window);
     // BasicModel::drawModelWithLight(window);
+    // BasicModel::drawModelStreaming(window);
     // Advanced::drawModel(window);
     // Advanced::drawModelWithBlender(window);
     //Advanced::drawExampleWithFramebuffer(window);
+    // Benchmark::modelLoading(root_path + "/Assets/nanosuit.obj");
+    // Benchmark::textureDecoding(root_path + "/Assets/nanosuit.obj");
+    // Benchmark::meshConversion(root_path + "/Assets/nanosuit.obj");
+    // Benchmark::meshOptimization(root_path + "/Assets/nanosuit.obj");
+    // Benchmark::vertexFormats(root_path + "/Assets/nanosuit.obj");
+    // Benchmark::indexBuffers(root_path + "/Assets/nanosuit.obj");
+    // Benchmark::geometryArena(root_path + "/Assets/nanosuit.obj");
+    // Benchmark::uploadBudget(window, root_path + "/Assets/nanosuit.obj");
+    // Benchmark::levelsOfDetail(window, root_path + "/Assets/nanosuit.obj", root_path + "/OpenGL/model/model.vs",
+    //                           root_path + "/OpenGL/model/model.fs");
+    // Benchmark::clusterCulling(window, root_path + "/Assets/nanosuit.obj", root_path + "/OpenGL/model/model.vs",
+    //                           root_path + "/OpenGL/model/model.fs");
+    // Benchmark::drawAllocations(window, root_path + "/Assets/nanosuit.obj", root_path + "/OpenGL/model/model.vs",
+    //                            root_path + "/OpenGL/model/model.fs");
+    // Benchmark::shaderStartup(root_path + "/OpenGL");
+    // Benchmark::stateChanges(window, root_path + "/Assets/nanosuit.obj", root_path + "/OpenGL/model/model.vs",
+    //                         root_path + "/OpenGL/model/model.fs");
+    // Benchmark::instancing(window, root_path + "/OpenGL/lighting/lamp_shader.vs",
+    //                       root_path + "/OpenGL/lighting/lamp_shader.fs");
+    // Benchmark::frustumCulling();
     Advanced::skyboxExample(window);
 
     glfwTerminate();
@@ -0,0 +1,766 @@
+#include "benchmark.h"
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <set>
+#include <thread>
+
+#include "allocation_counter.h"
+#include "assimp/Importer.hpp"
+#include "camera.h"
+#include "geometry_arena.h"
+#include "gl_state.h"
+#include "index_buffer.h"
+#include "instance_buffer.h"
+#include "mesh_cache.h"
+#include "program_cache.h"
+#include "shader_compile_queue.h"
+#include "model.h"
+#include "texture_cache.h"
+#include "texture_loader.h"
+#include "shader.h"
+
+namespace Benchmark {
+    static double timeModelLoad(const std::string& model_path)
+    {
+        double start = glfwGetTime();
+        {
+            Model model(model_path.c_str());
+            // Count the uploads as part of the load.
+            glFinish();
+        }
+        return (glfwGetTime() - start) * 1000.0;
+    }
+
+    void modelLoading(const std::string& model_path, int warm_runs)
+    {
+        // Cold load: parse with Assimp and write the cache.
+        std::remove(MeshCache::cachePath(model_path).c_str());
+        double cold_ms = timeModelLoad(model_path);
+
+        // Warm loads: map the cache written above.
+        double warm_ms = 0.0;
+        for (int i = 0; i < warm_runs; ++i) {
+            warm_ms += timeModelLoad(model_path);
+        }
+        warm_ms /= warm_runs;
+
+        std::cout << "Model loading: " << model_path << std::endl;
+        std::cout << "  cold (assimp + cache write): " << cold_ms << " ms" << std::endl;
+        std::cout << "  warm (mesh cache, avg of " << warm_runs << "): " << warm_ms << " ms" << std::endl;
+        std::cout << "  speedup: " << cold_ms / warm_ms << "x" << std::endl;
+    }
+
+    void textureDecoding(const std::string& model_path)
+    {
+        // Only the material table is needed.
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(model_path, 0);
+        if (scene == nullptr) {
+            std::cout << "ERROR::ASSIMP::" << importer.GetErrorString() << std::endl;
+            return;
+        }
+        std::string directory = model_path.substr(0, model_path.find_last_of('/'));
+        std::set<std::string> unique_files;
+        for (unsigned int i = 0; i < scene->mNumMaterials; ++i) {
+            for (aiTextureType type : {aiTextureType_DIFFUSE, aiTextureType_SPECULAR, aiTextureType_HEIGHT}) {
+                for (unsigned int j = 0; j < scene->mMaterials[i]->GetTextureCount(type); ++j) {
+                    aiString path;
+                    scene->mMaterials[i]->GetTexture(type, j, &path);
+                    unique_files.insert(directory + '/' + path.C_Str());
+                }
+            }
+        }
+        std::vector<std::string> filenames(unique_files.begin(), unique_files.end());
+
+        std::cout << "Texture decoding: " << filenames.size() << " textures of " << model_path << std::endl;
+        unsigned int max_workers = std::max(1u, std::thread::hardware_concurrency());
+        double single_ms = 0.0;
+        for (unsigned int workers = 1; workers <= max_workers; workers *= 2) {
+            ThreadPool pool(workers);
+            double start = glfwGetTime();
+            std::vector<unsigned int> textures = TextureLoader::loadAll(filenames, pool);
+            glFinish();
+            double elapsed_ms = (glfwGetTime() - start) * 1000.0;
+            glDeleteTextures(static_cast<GLsizei>(textures.size()), textures.data());
+
+            if (workers == 1) {
+                single_ms = elapsed_ms;
+            }
+            std::cout << "  " << workers << " worker(s): " << elapsed_ms << " ms (" << single_ms / elapsed_ms
+                      << "x)" << std::endl;
+        }
+    }
+
+    void meshConversion(const std::string& model_path, int runs)
+    {
+        std::cout << "Mesh conversion: " << model_path << std::endl;
+        double parse_ms = 0.0;
+        double serial_ms = 0.0;
+        double parallel_ms = 0.0;
+        size_t meshes = 0;
+        for (int i = 0; i < runs; ++i) {
+            Model::ConversionTimes serial;
+            Model::ConversionTimes parallel;
+            if (!Model::timeConversion(model_path, nullptr, serial) ||
+                !Model::timeConversion(model_path, &ThreadPool::shared(), parallel)) {
+                return;
+            }
+            parse_ms += serial.parse_ms + parallel.parse_ms;
+            serial_ms += serial.convert_ms;
+            parallel_ms += parallel.convert_ms;
+            meshes = serial.meshes;
+        }
+        parse_ms /= 2 * runs;
+        serial_ms /= runs;
+        parallel_ms /= runs;
+
+        std::cout << "  " << meshes << " meshes, assimp parse " << parse_ms << " ms (avg of " << runs << ")"
+                  << std::endl;
+        std::cout << "  convert, 1 thread: " << serial_ms << " ms" << std::endl;
+        std::cout << "  convert, " << ThreadPool::shared().workerCount() + 1 << " threads: " << parallel_ms << " ms ("
+                  << serial_ms / parallel_ms << "x)" << std::endl;
+    }
+
+    void meshOptimization(const std::string& model_path)
+    {
+        // Without a cache the meshes are imported and optimized again.
+        std::remove(MeshCache::cachePath(model_path).c_str());
+        double start = glfwGetTime();
+        Model model(model_path.c_str());
+        double import_ms = (glfwGetTime() - start) * 1000.0;
+
+        std::cout << "Mesh optimization: " << model_path << " (cold import " << import_ms << " ms)" << std::endl;
+        const std::vector<MeshOptimizer::Report>& reports = model.optimizationReports();
+        for (size_t i = 0; i < reports.size(); ++i) {
+            const MeshOptimizer::Report& report = reports[i];
+            std::cout << "  mesh " << i << ": vertices " << report.source_vertex_count << " -> " << report.vertex_count
+                      << ", ACMR " << report.before.acmr << " -> " << report.after.acmr << ", ATVR "
+                      << report.before.atvr << " -> " << report.after.atvr << std::endl;
+        }
+    }
+
+    void vertexFormats(const std::string& model_path)
+    {
+        std::cout << "Vertex formats: " << model_path << std::endl;
+        const VertexFormat formats[] = {VertexFormat::FLOAT, VertexFormat::HALF, VertexFormat::UNORM16};
+        const char* names[] = {"float", "half", "unorm16"};
+        for (int f = 0; f < 3; ++f) {
+            Model model(model_path.c_str(), ThreadPool::shared(), formats[f]);
+            GeometryArena::Stats stats = GeometryArena::shared(formats[f]).stats();
+            std::cout << "  " << names[f] << ": " << vertexStride(formats[f]) << " bytes per vertex, "
+                      << stats.vertex_used * vertexStride(formats[f]) / 1024 << " KiB of vertices" << std::endl;
+
+            const std::vector<QuantizationError>& errors = model.quantizationReports();
+            for (size_t i = 0; i < errors.size(); ++i) {
+                std::cout << "    mesh " << i << ": position " << errors[i].position << ", normal "
+                          << errors[i].normal_degrees << " deg, uv " << errors[i].tex_coords << std::endl;
+            }
+        }
+    }
+
+    void indexBuffers(const std::string& model_path)
+    {
+        // Make sure the cache is current, then read it back.
+        {
+            Model model(model_path.c_str());
+        }
+        MeshCache::Key key;
+        MeshCache::Reader reader;
+        if (!MeshCache::makeKey(model_path, Model::IMPORT_FLAGS, key) ||
+            !reader.open(MeshCache::cachePath(model_path), key)) {
+            std::cout << "ERROR::BENCHMARK::NO_MESH_CACHE " << model_path << std::endl;
+            return;
+        }
+
+        size_t index_count = 0;
+        size_t chunk_count = 0;
+        std::vector<std::vector<unsigned char>> encoded(reader.meshes().size());
+        size_t encoded_bytes = 0;
+        for (size_t i = 0; i < reader.meshes().size(); ++i) {
+            const MeshCache::CookedMesh& mesh = reader.meshes()[i];
+            index_count += mesh.index_count;
+            chunk_count += mesh.chunks.size();
+            IndexBuffer::encode(mesh.indices, mesh.index_count, encoded[i]);
+            encoded_bytes += encoded[i].size();
+        }
+
+        const int runs = 20;
+        std::vector<uint16_t> decoded(index_count);
+        double start = glfwGetTime();
+        for (int run = 0; run < runs; ++run) {
+            uint16_t* out = decoded.data();
+            for (size_t i = 0; i < encoded.size(); ++i) {
+                const MeshCache::CookedMesh& mesh = reader.meshes()[i];
+                IndexBuffer::decode(encoded[i].data(), encoded[i].size(), out, mesh.index_count);
+                out += mesh.index_count;
+            }
+        }
+        double decode_ms = (glfwGetTime() - start) * 1000.0 / runs;
+
+        std::cout << "Index buffers: " << model_path << " (" << reader.meshes().size() << " meshes, " << chunk_count
+                  << " chunks, " << index_count << " indices)" << std::endl;
+        std::cout << "  32-bit: " << index_count * 4 / 1024 << " KiB" << std::endl;
+        std::cout << "  16-bit: " << index_count * 2 / 1024 << " KiB" << std::endl;
+        std::cout << "  encoded: " << encoded_bytes / 1024 << " KiB (" << double(encoded_bytes) / index_count
+                  << " bytes per index), decoded in " << decode_ms << " ms" << std::endl;
+    }
+
+    static void printArenaStats(const char* name)
+    {
+        GeometryArena::Stats stats = GeometryArena::shared().stats();
+        std::cout << "  " << name << ": " << stats.allocations << " allocations, vertices " << stats.vertex_used << "/"
+                  << stats.vertex_capacity << ", indices " << stats.index_used << "/" << stats.index_capacity << ", "
+                  << stats.bytes / 1024 << " KiB, " << stats.free_blocks << " free blocks, fragmentation "
+                  << stats.vertex_fragmentation * 100.0f << "% / " << stats.index_fragmentation * 100.0f << "%"
+                  << std::endl;
+    }
+
+    void geometryArena(const std::string& model_path)
+    {
+        std::cout << "Geometry arena: " << model_path << std::endl;
+        std::unique_ptr<Model> first(new Model(model_path.c_str()));
+        std::unique_ptr<Model> second(new Model(model_path.c_str()));
+        printArenaStats("two copies");
+
+        // Leaves a hole in front of the second copy.
+        first.reset();
+        printArenaStats("first dropped");
+
+        double start = glfwGetTime();
+        size_t moved = GeometryArena::shared().defragment();
+        glFinish();
+        std::cout << "  defragment moved " << moved / 1024 << " KiB in " << (glfwGetTime() - start) * 1000.0 << " ms"
+                  << std::endl;
+        printArenaStats("defragmented");
+    }
+
+    // One streaming run, returns the time of every frame until all models were resident.
+    static std::vector<double> streamModels(GLFWwindow* window, const std::string& model_path, int copies,
+                                            size_t& resident_uploads)
+    {
+        UploadQueue& uploads = UploadQueue::main();
+        uploads.setResidencyListener(
+            [&resident_uploads](const std::string&, size_t, size_t) { ++resident_uploads; });
+
+        std::vector<std::future<std::unique_ptr<Model>>> pending;
+        for (int i = 0; i < copies; ++i) {
+            pending.push_back(Model::loadAsync(model_path));
+        }
+        std::vector<std::unique_ptr<Model>> models;
+        std::vector<double> frame_ms;
+
+        double last = glfwGetTime();
+        while (models.size() < pending.size() && !glfwWindowShouldClose(window)) {
+            uploads.process();
+            for (auto& future : pending) {
+                if (future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+                    models.push_back(future.get());
+                }
+            }
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            // Wait for the GPU so the upload cost shows up in the frame that issued it.
+            glFinish();
+
+            double now = glfwGetTime();
+            frame_ms.push_back((now - last) * 1000.0);
+            last = now;
+        }
+        uploads.setResidencyListener(nullptr);
+        // Dropping the models releases the textures, so the next run decodes and uploads them again.
+        return frame_ms;
+    }
+
+    static void printFrameTimes(const char* name, const std::vector<double>& frame_ms, size_t resident_uploads)
+    {
+        if (frame_ms.empty()) {
+            return;
+        }
+        std::vector<double> sorted = frame_ms;
+        std::sort(sorted.begin(), sorted.end());
+        double average = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+        std::cout << "  " << name << ": " << frame_ms.size() << " frames, " << resident_uploads
+                  << " uploads, avg " << average << " ms, p95 " << sorted[sorted.size() * 95 / 100] << " ms, max "
+                  << sorted.back() << " ms" << std::endl;
+        std::cout << "    frame ms:";
+        for (double ms : frame_ms) {
+            std::cout << ' ' << ms;
+        }
+        std::cout << std::endl;
+    }
+
+    void uploadBudget(GLFWwindow* window, const std::string& model_path, int copies, size_t budget_bytes,
+                      double budget_ms)
+    {
+        // Without vsync the frame time is the work done in the frame.
+        glfwSwapInterval(0);
+        UploadQueue& uploads = UploadQueue::main();
+        std::cout << "Upload budget: " << copies << " x " << model_path << std::endl;
+
+        size_t resident_uploads = 0;
+        uploads.setBudget(0, 0.0);
+        std::vector<double> unlimited = streamModels(window, model_path, copies, resident_uploads);
+        printFrameTimes("unlimited", unlimited, resident_uploads);
+
+        resident_uploads = 0;
+        uploads.setBudget(budget_bytes, budget_ms);
+        std::vector<double> budgeted = streamModels(window, model_path, copies, resident_uploads);
+        std::cout << "  budget " << budget_bytes / 1024 << " KiB / " << budget_ms << " ms per frame" << std::endl;
+        printFrameTimes("budgeted", budgeted, resident_uploads);
+
+        uploads.setBudget(0, 0.0);
+        glfwSwapInterval(1);
+    }
+
+    // Renders the instance field for `frames` frames, returns the average frame time and sets the average
+    // triangles per frame. A max_pixel_error of 0 keeps every mesh at full detail.
+    static double drawLodField(GLFWwindow* window, Model& model, Shader& shader,
+                               const std::vector<glm::mat4>& transforms, int frames, float max_pixel_error,
+                               size_t& triangles_per_frame)
+    {
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        Camera camera(glm::vec3(0.0f, 8.0f, 10.0f));
+        glm::mat4 projection =
+            glm::perspective(glm::radians(camera.zoom_), float(width) / std::max(height, 1), 0.1f, 1000.0f);
+
+        shader.use();
+        camera.updateFrameUniforms(projection, 0.0f);
+
+        size_t triangles = 0;
+        double start = glfwGetTime();
+        for (int frame = 0; frame < frames && !glfwWindowShouldClose(window); ++frame) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            for (const glm::mat4& transform : transforms) {
+                triangles += model.draw(shader, transform, camera, float(height), max_pixel_error);
+            }
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            // Wait for the GPU so the frame time includes the vertex work the LODs save.
+            glFinish();
+        }
+        triangles_per_frame = triangles / std::max(frames, 1);
+        return (glfwGetTime() - start) * 1000.0 / std::max(frames, 1);
+    }
+
+    void levelsOfDetail(GLFWwindow* window, const std::string& model_path, const std::string& vertex_path,
+                        const std::string& fragment_path, int instances, int frames, float max_pixel_error)
+    {
+        glfwSwapInterval(0);
+        glEnable(GL_DEPTH_TEST);
+        Shader shader(vertex_path.c_str(), fragment_path.c_str());
+        Model model(model_path.c_str());
+
+        std::cout << "Levels of detail: " << instances << " x " << model_path << std::endl;
+
+        // A square field in front of the camera, spaced by the model's size so the far rows are a few pixels tall.
+        int side = static_cast<int>(std::ceil(std::sqrt(double(instances))));
+        std::vector<glm::mat4> transforms;
+        for (int i = 0; i < instances; ++i) {
+            float x = (i % side - side * 0.5f) * 12.0f;
+            float z = -(i / side) * 12.0f;
+            transforms.push_back(glm::translate(glm::mat4(1.0f), glm::vec3(x, 0.0f, z)));
+        }
+
+        size_t full_triangles = 0;
+        double full_ms = drawLodField(window, model, shader, transforms, frames, 0.0f, full_triangles);
+        size_t lod_triangles = 0;
+        double lod_ms = drawLodField(window, model, shader, transforms, frames, max_pixel_error, lod_triangles);
+
+        std::cout << "  full detail: " << full_ms << " ms/frame, " << full_triangles << " triangles/frame"
+                  << std::endl;
+        std::cout << "  lod (" << max_pixel_error << " px): " << lod_ms << " ms/frame, " << lod_triangles
+                  << " triangles/frame" << std::endl;
+        if (full_triangles > 0 && full_ms > 0.0) {
+            std::cout << "  saved " << 100.0 * (1.0 - double(lod_triangles) / full_triangles) << "% triangles, "
+                      << 100.0 * (1.0 - lod_ms / full_ms) << "% frame time" << std::endl;
+        }
+        glfwSwapInterval(1);
+    }
+
+    void clusterCulling(GLFWwindow* window, const std::string& model_path, const std::string& vertex_path,
+                        const std::string& fragment_path)
+    {
+        glEnable(GL_DEPTH_TEST);
+        Shader shader(vertex_path.c_str(), fragment_path.c_str());
+        Model model(model_path.c_str());
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+
+        struct View {
+            const char* name;
+            glm::vec3 position;
+            float yaw;
+            float pitch;
+        };
+        // The nanosuit stands on the origin and is about 15 units tall.
+        const View views[] = {
+            {"front", glm::vec3(0.0f, 8.0f, 12.0f), -90.0f, 0.0f},
+            {"helmet close-up", glm::vec3(0.0f, 14.5f, 3.0f), -90.0f, 0.0f},
+            {"side", glm::vec3(12.0f, 8.0f, 0.0f), 180.0f, 0.0f},
+            {"back", glm::vec3(0.0f, 8.0f, -12.0f), 90.0f, 0.0f},
+            {"legs from above", glm::vec3(0.0f, 12.0f, 4.0f), -90.0f, -60.0f},
+            {"half turned away", glm::vec3(0.0f, 8.0f, 12.0f), -45.0f, 0.0f},
+        };
+
+        std::cout << "Cluster culling: " << model_path << std::endl;
+        for (const View& view : views) {
+            Camera camera(view.position, glm::vec3(0.0f, 1.0f, 0.0f), view.yaw, view.pitch);
+            glm::mat4 projection =
+                glm::perspective(glm::radians(camera.zoom_), float(width) / std::max(height, 1), 0.1f, 100.0f);
+            shader.use();
+            camera.updateFrameUniforms(projection, 0.0f);
+
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            Culling::Stats stats;
+            // Full detail only, so the numbers show the culling alone.
+            model.draw(shader, glm::mat4(1.0f), camera, projection, float(height), 0.0f, stats);
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+
+            double culled = stats.triangles > 0 ? 100.0 * (1.0 - double(stats.triangles_drawn) / stats.triangles) : 0.0;
+            std::cout << "  " << view.name << ": " << stats.clusters << " clusters, " << stats.frustum_culled
+                      << " outside the frustum, " << stats.backface_culled << " back-facing; "
+                      << stats.triangles_drawn << " / " << stats.triangles << " triangles drawn (" << culled
+                      << "% culled) in " << stats.draw_calls << " draws" << std::endl;
+        }
+    }
+
+    void drawAllocations(GLFWwindow* window, const std::string& model_path, const std::string& vertex_path,
+                         const std::string& fragment_path, int frames)
+    {
+        glEnable(GL_DEPTH_TEST);
+        Shader shader(vertex_path.c_str(), fragment_path.c_str());
+        Model model(model_path.c_str());
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        Camera camera(glm::vec3(0.0f, 8.0f, 12.0f));
+        glm::mat4 projection =
+            glm::perspective(glm::radians(camera.zoom_), float(width) / std::max(height, 1), 0.1f, 100.0f);
+        glm::mat4 transform(1.0f);
+
+        struct Path {
+            const char* name;
+            std::function<void()> draw;
+        };
+        Culling::Stats stats;
+        const Path paths[] = {
+            {"plain", [&] { model.draw(shader, transform); }},
+            {"lod", [&] { model.draw(shader, transform, camera, float(height), 1.0f); }},
+            {"culled", [&] { model.draw(shader, transform, camera, projection, float(height), 1.0f, stats); }},
+        };
+
+        std::cout << "Draw allocations: " << model_path << std::endl;
+        for (const Path& path : paths) {
+            size_t allocations = 0;
+            size_t bytes = 0;
+            for (int frame = 0; frame <= frames; ++frame) {
+                glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+                // Only the draw itself is counted, swapping and polling belong to GLFW and the driver.
+                AllocationCounter::Scope scope;
+                shader.use();
+                camera.updateFrameUniforms(projection, float(frame));
+                path.draw();
+                // Frame 0 warms up whatever is set up lazily.
+                if (frame > 0) {
+                    allocations += scope.allocations();
+                    bytes += scope.bytes();
+                }
+                glfwSwapBuffers(window);
+                glfwPollEvents();
+            }
+            std::cout << "  " << path.name << ": " << double(allocations) / frames << " allocations, "
+                      << double(bytes) / frames << " bytes per frame" << std::endl;
+            if (allocations > 0) {
+                std::cout << "ERROR::BENCHMARK::DRAW_PATH_ALLOCATES" << std::endl;
+            }
+        }
+    }
+
+    static double timeShaderBuilds(const std::string& shader_dir, const char* const (*programs)[2], size_t count)
+    {
+        double start = glfwGetTime();
+        for (size_t i = 0; i < count; ++i) {
+            Shader shader((shader_dir + '/' + programs[i][0]).c_str(), (shader_dir + '/' + programs[i][1]).c_str());
+        }
+        // Drivers may finish linking lazily, count that as part of startup.
+        glFinish();
+        return (glfwGetTime() - start) * 1000.0;
+    }
+
+    void stateChanges(GLFWwindow* window, const std::string& model_path, const std::string& vertex_path,
+                      const std::string& fragment_path, int copies, int frames)
+    {
+        Shader shader(vertex_path.c_str(), fragment_path.c_str());
+        Model model(model_path.c_str());
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        Camera camera(glm::vec3(0.0f, 8.0f, 12.0f * copies));
+        glm::mat4 projection =
+            glm::perspective(glm::radians(camera.zoom_), float(width) / std::max(height, 1), 0.1f, 1000.0f);
+        PipelineState::Desc opaque_desc;
+        opaque_desc.depth.test = true;
+        const PipelineState opaque(opaque_desc);
+
+        GlState& state = GlState::shared();
+        GlState::FrameStats total;
+        for (int frame = 0; frame <= frames; ++frame) {
+            // What a frame per object would set by hand: its pipeline state, program, vertex array and textures.
+            state.apply(opaque);
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            camera.updateFrameUniforms(projection, float(frame));
+            for (int i = 0; i < copies; ++i) {
+                state.apply(opaque);
+                shader.use();
+                model.draw(shader, glm::translate(glm::mat4(1.0f), glm::vec3(4.0f * (i - copies / 2), 0.0f, 0.0f)));
+            }
+            state.endFrame();
+            // Frame 0 starts from unknown state and has to set everything.
+            if (frame > 0) {
+                total.calls += state.lastFrame().calls;
+                total.redundant += state.lastFrame().redundant;
+            }
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+
+        std::cout << "State changes: " << copies << " x " << model_path << std::endl;
+        std::cout << "  issued " << double(total.calls) / frames << ", dropped as redundant "
+                  << double(total.redundant) / frames << " state calls per frame" << std::endl;
+    }
+
+    // Unit cube around the origin with a normal per face.
+    static Mesh makeCube()
+    {
+        std::vector<Vertex> vertices;
+        std::vector<unsigned int> indices;
+        const glm::vec2 corners[] = {{-1.0f, -1.0f}, {1.0f, -1.0f}, {1.0f, 1.0f}, {-1.0f, 1.0f}};
+        for (int axis = 0; axis < 3; ++axis) {
+            for (float sign : {-1.0f, 1.0f}) {
+                glm::vec3 normal(0.0f);
+                normal[axis] = sign;
+                glm::vec3 u(0.0f);
+                u[(axis + 1) % 3] = 0.5f;
+                glm::vec3 v(0.0f);
+                v[(axis + 2) % 3] = 0.5f;
+                unsigned int first = static_cast<unsigned int>(vertices.size());
+                for (const glm::vec2& corner : corners) {
+                    vertices.push_back({normal * 0.5f + u * corner.x + v * corner.y, normal, (corner + 1.0f) * 0.5f});
+                }
+                // u x v points along +axis, so the negative faces turn the other way to stay counter-clockwise.
+                const unsigned int order[2][6] = {{0, 2, 1, 0, 3, 2}, {0, 1, 2, 0, 2, 3}};
+                for (unsigned int corner : order[sign > 0.0f]) {
+                    indices.push_back(first + corner);
+                }
+            }
+        }
+        return Mesh(std::move(vertices), std::move(indices), {}, false);
+    }
+
+    // Spins every cube of the grid a little per frame, so both paths upload all transforms every frame.
+    static void animateCubeGrid(std::vector<glm::mat4>& transforms, int side, float time)
+    {
+        for (size_t i = 0; i < transforms.size(); ++i) {
+            glm::vec3 position((int(i) % side - side * 0.5f) * 2.0f, 0.0f, (int(i) / side - side * 0.5f) * 2.0f);
+            transforms[i] = glm::rotate(glm::translate(glm::mat4(1.0f), position), time + i * 0.01f,
+                                        glm::vec3(0.0f, 1.0f, 0.0f));
+        }
+    }
+
+    // Milliseconds per frame of drawing `count` cubes, as `count` draw calls or as one instanced draw.
+    static double drawCubeGrid(GLFWwindow* window, Mesh& cube, Shader& individual, Shader& instanced, size_t count,
+                               bool instancing, int frames)
+    {
+        int side = static_cast<int>(std::ceil(std::sqrt(double(count))));
+        int width = 0;
+        int height = 0;
+        glfwGetFramebufferSize(window, &width, &height);
+        Camera camera(glm::vec3(0.0f, side * 1.0f, side * 1.5f), glm::vec3(0.0f, 1.0f, 0.0f), -90.0f, -35.0f);
+        glm::mat4 projection =
+            glm::perspective(glm::radians(camera.zoom_), float(width) / std::max(height, 1), 0.1f, side * 6.0f);
+        camera.updateFrameUniforms(projection, 0.0f);
+
+        Shader& shader = instancing ? instanced : individual;
+        shader.use();
+        Uniform model = shader.uniform("model");
+        shader.setMat4(model, glm::mat4(1.0f));
+        std::vector<glm::mat4> transforms(count);
+        InstanceBuffer instances;
+
+        double start = glfwGetTime();
+        for (int frame = 0; frame < frames && !glfwWindowShouldClose(window); ++frame) {
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            animateCubeGrid(transforms, side, frame * 0.02f);
+            if (instancing) {
+                instances.update(transforms);
+                cube.drawInstanced(shader, instances);
+            } else {
+                for (const glm::mat4& transform : transforms) {
+                    shader.setMat4(model, transform);
+                    cube.draw(shader);
+                }
+            }
+            glfwSwapBuffers(window);
+            glfwPollEvents();
+            // Wait for the GPU, so the instanced frames pay for the vertex work they queue.
+            glFinish();
+        }
+        return (glfwGetTime() - start) * 1000.0 / std::max(frames, 1);
+    }
+
+    void instancing(GLFWwindow* window, const std::string& vertex_path, const std::string& fragment_path, int frames)
+    {
+        glfwSwapInterval(0);
+        glEnable(GL_DEPTH_TEST);
+        Shader individual(vertex_path.c_str(), fragment_path.c_str());
+        Shader instanced(vertex_path.c_str(), fragment_path.c_str(), {{"INSTANCED", "1"}});
+        Mesh cube = makeCube();
+
+        std::cout << "Instancing: " << vertex_path << std::endl;
+        for (size_t count : {size_t(10000), size_t(30000), size_t(100000)}) {
+            double individual_ms = drawCubeGrid(window, cube, individual, instanced, count, false, frames);
+            double instanced_ms = drawCubeGrid(window, cube, individual, instanced, count, true, frames);
+            std::cout << "  " << count << " cubes: " << individual_ms << " ms/frame in " << count << " draws, "
+                      << instanced_ms << " ms/frame in 1 draw (" << instanced_ms * 1e6 / count
+                      << " ns per cube)";
+            if (instanced_ms > 0.0) {
+                std::cout << ", " << individual_ms / instanced_ms << "x";
+            }
+            std::cout << std::endl;
+        }
+        glfwSwapInterval(1);
+    }
+
+    // Seconds per run of `cull` over all boxes.
+    static double timeCulling(size_t (*cull)(const Culling::Frustum&, const Culling::Boxes&, std::vector<uint32_t>&),
+                              const Culling::Frustum& frustum, const Culling::Boxes& boxes, int runs,
+                              std::vector<uint32_t>& visible)
+    {
+        double start = glfwGetTime();
+        for (int run = 0; run < runs; ++run) {
+            cull(frustum, boxes, visible);
+        }
+        return (glfwGetTime() - start) / std::max(runs, 1);
+    }
+
+    void frustumCulling(size_t box_count, int runs)
+    {
+        // Boxes scattered around a camera at the origin, so about a tenth of them is in view.
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+        std::uniform_real_distribution<float> extent(0.5f, 4.0f);
+        Culling::Boxes boxes;
+        for (size_t i = 0; i < box_count; ++i) {
+            Culling::Box box;
+            box.center = glm::vec3(position(random), position(random), position(random));
+            box.extent = glm::vec3(extent(random), extent(random), extent(random));
+            boxes.add(box);
+        }
+        Camera camera(glm::vec3(0.0f));
+        Culling::Frustum frustum = camera.getFrustum(glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 200.0f));
+
+        std::vector<uint32_t> simd_visible;
+        std::vector<uint32_t> scalar_visible;
+        double simd_s = timeCulling(Culling::cullBoxes, frustum, boxes, runs, simd_visible);
+        double scalar_s = timeCulling(Culling::cullBoxesScalar, frustum, boxes, runs, scalar_visible);
+
+        std::cout << "Frustum culling: " << box_count << " boxes, " << simd_visible.size() << " visible" << std::endl;
+        std::cout << "  " << Culling::simdName() << ": " << simd_s * 1e6 << " us, "
+                  << box_count / std::max(simd_s * 1e9, 1e-9) << " boxes/ns" << std::endl;
+        std::cout << "  scalar: " << scalar_s * 1e6 << " us, " << box_count / std::max(scalar_s * 1e9, 1e-9)
+                  << " boxes/ns" << std::endl;
+        if (simd_s > 0.0) {
+            std::cout << "  speedup: " << scalar_s / simd_s << "x" << std::endl;
+        }
+        if (simd_visible != scalar_visible) {
+            std::cout << "ERROR::BENCHMARK::CULLING_MISMATCH" << std::endl;
+        }
+    }
+
+    // Submits every program through a ShaderCompileQueue. `submit_ms` is how long the calling thread was held up
+    // handing them over, the result how long until all of them were ready.
+    static double timeQueuedShaderBuilds(const std::string& shader_dir, const char* const (*programs)[2],
+                                         size_t count, double& submit_ms)
+    {
+        double start = glfwGetTime();
+        ShaderCompileQueue queue;
+        for (size_t i = 0; i < count; ++i) {
+            queue.submit(shader_dir + '/' + programs[i][0], shader_dir + '/' + programs[i][1]);
+        }
+        submit_ms = (glfwGetTime() - start) * 1000.0;
+        while (queue.process() > 0) {
+            std::this_thread::yield();
+        }
+        glFinish();
+        return (glfwGetTime() - start) * 1000.0;
+    }
+
+    void shaderStartup(const std::string& shader_dir, int warm_runs)
+    {
+        const char* const programs[][2] = {
+            {"getting_started/shader.vs", "getting_started/shader.fs"},
+            {"getting_started/box_shader.vs", "getting_started/box_shader.fs"},
+            {"lighting/box_shader.vs", "lighting/box_shader.fs"},
+            {"lighting/lamp_shader.vs", "lighting/lamp_shader.fs"},
+            {"model/model.vs", "model/model.fs"},
+            {"model/model_shader.vs", "model/model_shader.fs"},
+            {"model/lamp_shader.vs", "model/lamp_shader.fs"},
+            {"model/2.stencil_testing.vs", "model/2.stencil_testing.fs"},
+            {"model/2.stencil_testing.vs", "model/2.stencil_single_color.fs"},
+            {"model/3.2.blending.vs", "model/3.2.blending.fs"},
+            {"advanced/5.1.framebuffers.vs", "advanced/5.1.framebuffers.fs"},
+            {"advanced/5.1.framebuffers_screen.vs", "advanced/5.1.framebuffers_screen.fs"},
+            {"advanced/6.1.cubemaps.vs", "advanced/6.1.cubemaps.fs"},
+            {"advanced/6.1.skybox.vs", "advanced/6.1.skybox.fs"},
+        };
+        size_t count = sizeof(programs) / sizeof(programs[0]);
+
+        std::cout << "Shader startup: " << count << " programs" << std::endl;
+        if (!ProgramCache::supported()) {
+            std::cout << "  program binaries are not supported by this driver, every run compiles" << std::endl;
+        }
+
+        // Cold through the queue first, the driver's own cache only helps the runs after it.
+        ProgramCache::clear();
+        double queued_submit_ms = 0.0;
+        double queued_ms = timeQueuedShaderBuilds(shader_dir, programs, count, queued_submit_ms);
+
+        // Cold: compile and link everything and fill the cache. The driver's own cache may still help.
+        ProgramCache::clear();
+        double cold_ms = timeShaderBuilds(shader_dir, programs, count);
+        ProgramCache::Stats cold = ProgramCache::stats();
+
+        double warm_ms = 0.0;
+        for (int i = 0; i < warm_runs; ++i) {
+            warm_ms += timeShaderBuilds(shader_dir, programs, count);
+        }
+        warm_ms /= std::max(warm_runs, 1);
+        const ProgramCache::Stats& total = ProgramCache::stats();
+
+        std::cout << "  cold, queued (" << (ShaderCompileQueue::parallelCompileSupported() ? "parallel" : "serial")
+                  << " compile): submitted in " << queued_submit_ms << " ms, all ready after " << queued_ms << " ms"
+                  << std::endl;
+        std::cout << "  cold (compile + link + store): " << cold_ms << " ms, " << cold.misses << " misses"
+                  << std::endl;
+        std::cout << "  warm (program binaries, avg of " << warm_runs << "): " << warm_ms << " ms, "
+                  << total.hits << " hits, " << total.rejected << " rejected" << std::endl;
+        if (warm_ms > 0.0) {
+            std::cout << "  speedup: " << cold_ms / warm_ms << "x" << std::endl;
+        }
+    }
+}  // namespace Benchmark
@@ -0,0 +1,64 @@
+#pragma once
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <cstddef>
+#include <string>
+
+struct GLFWwindow;
+
+// Measurements that expect a current GL context. The ones taking a window run their own frame loop.
+namespace Benchmark {
+    // Loads the model without and then with its mesh cache and prints both timings.
+    void modelLoading(const std::string& model_path, int warm_runs = 5);
+    // Loads every texture the model's materials reference with 1, 2, 4, ... workers and prints the wall-clock time.
+    void textureDecoding(const std::string& model_path);
+    // Times the Assimp parse and the mesh conversion of a cold import, converting the meshes on one thread and
+    // then in parallel on the shared pool.
+    void meshConversion(const std::string& model_path, int runs = 3);
+    // Re-imports the model and prints the vertex count and ACMR/ATVR of every mesh before and after optimization.
+    void meshOptimization(const std::string& model_path);
+    // Loads the model in every VertexFormat and prints the vertex memory and the per-mesh quantization error.
+    void vertexFormats(const std::string& model_path);
+    // Compares the model's index data as 32-bit, 16-bit and encoded in the mesh cache, and times decoding.
+    void indexBuffers(const std::string& model_path);
+    // Loads the model twice, drops the first copy and prints the GeometryArena usage and fragmentation before and
+    // after defragmenting.
+    void geometryArena(const std::string& model_path);
+    // Streams `copies` instances of the model in through Model::loadAsync while rendering empty frames, once with
+    // an unlimited UploadQueue and once under the given budget, and prints the frame times of both runs.
+    void uploadBudget(GLFWwindow* window, const std::string& model_path, int copies = 8,
+                      size_t budget_bytes = 8 << 20, double budget_ms = 2.0);
+    // Renders a field of `instances` copies of the model receding from a fixed camera for `frames` frames, once at
+    // full detail and once with Model's screen-space error LOD selection, and prints the frame time and the
+    // triangles drawn per frame of both runs.
+    void levelsOfDetail(GLFWwindow* window, const std::string& model_path, const std::string& vertex_path,
+                        const std::string& fragment_path, int instances = 400, int frames = 300,
+                        float max_pixel_error = 1.0f);
+    // Draws the model from a few typical camera views with meshlet culling and prints per view how many clusters
+    // the frustum and the normal cones rejected and how many triangles and draw calls were left.
+    void clusterCulling(GLFWwindow* window, const std::string& model_path, const std::string& vertex_path,
+                        const std::string& fragment_path);
+    // Draws the model through the plain, the LOD and the culled draw path for `frames` frames each after one
+    // warm-up frame and prints the heap allocations per frame of each, which should all be zero.
+    void drawAllocations(GLFWwindow* window, const std::string& model_path, const std::string& vertex_path,
+                         const std::string& fragment_path, int frames = 100);
+    // Draws `copies` of the model per frame for `frames` frames, setting pipeline state, program and bindings per
+    // copy, and prints how many of those calls GlState issued and how many it dropped as redundant per frame.
+    void stateChanges(GLFWwindow* window, const std::string& model_path, const std::string& vertex_path,
+                      const std::string& fragment_path, int copies = 16, int frames = 100);
+    // Renders grids of 10k, 30k and 100k unit cubes for `frames` frames each, once with one draw call per cube and
+    // once as a single instanced draw, rewriting every transform each frame in both, and prints the frame times. The
+    // shaders need an INSTANCED permutation, see common/instancing.glsl.
+    void instancing(GLFWwindow* window, const std::string& vertex_path, const std::string& fragment_path,
+                    int frames = 100);
+    // Culls `box_count` random boxes against a camera frustum `runs` times with the SIMD and the scalar test, checks
+    // both keep the same boxes and prints how many boxes each tests per nanosecond. CPU only.
+    void frustumCulling(size_t box_count = 100000, int runs = 200);
+    // Builds every shader program of the demos under `shader_dir` (the OpenGL/ source folder) once through a
+    // ShaderCompileQueue and once blocking, each with an empty ProgramCache, then `warm_runs` times from the cache,
+    // and prints the startup times and the cache hits.
+    void shaderStartup(const std::string& shader_dir, int warm_runs = 5);
+}  // namespace Benchmark
+
+#endif
@@ -1,5 +1,7 @@
 #include "camera.h"
 
+#include "frame_uniforms.h"
+
 Camera::Camera(glm::vec3 position, glm::vec3 up, float yaw, float pitch)
     : position_(position)
     , world_up_(up)
@@ -18,6 +20,11 @@ Camera::Camera(float pos_x, float pos_y, float pos_z, float up_x, float up_y, fl
 {
 }
 
+void Camera::updateFrameUniforms(const glm::mat4& projection, float time) const
+{
+    FrameUniforms::shared().update(getViewMatrix(), projection, position_, time);
+}
+
 void Camera::processKeyboard(CameraMovement direction, float delta_time)
 {
     float velocity = movement_speed_ * delta_time;
@@ -6,6 +6,8 @@
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
 
+#include "culling.h"
+
 enum CameraMovement {
 	FORWARD,
 	BACKWARD,
@@ -40,11 +42,21 @@ public:
            float yaw = YAW, float pitch = PITCH);
     Camera(float pos_x, float pos_y, float pos_z, float up_x, float up_y, float up_z, float yaw, float pitch);
 
-    glm::mat4 getViewMatrix()
+    glm::mat4 getViewMatrix() const
     {
         return glm::lookAt(position_, position_ + front_, up_);
     }
 
+    // World space frustum of this view through `projection`.
+    Culling::Frustum getFrustum(const glm::mat4& projection) const
+    {
+        return Culling::extractFrustum(projection * getViewMatrix());
+    }
+
+    // Publishes this frame's view, projection, position and time to the shaders through FrameUniforms. Call once
+    // per frame, only the time is uploaded while the camera stands still.
+    void updateFrameUniforms(const glm::mat4& projection, float time) const;
+
     void processKeyboard(CameraMovement direction, float delta_time);
     void processMouseMovement(float xoffset, float yoffset, GLboolean constrain_pitch = true);
     void processMouseScroll(float yoffset);
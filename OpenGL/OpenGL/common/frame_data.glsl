@@ -0,0 +1,8 @@
+// Per-frame values shared by every program, see FrameUniforms (binding point 0, std140).
+layout (std140) uniform FrameData {
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    float time;
+};
@@ -0,0 +1,20 @@
+// Model matrix of the vertex shaders. With INSTANCED 1 each instance adds its own transform from the InstanceBuffer
+// on top of the "model" uniform, which then only holds what all instances share (e.g. the node of a Model).
+#ifndef INSTANCED
+#define INSTANCED 0
+#endif
+
+uniform mat4 model;
+#if INSTANCED
+layout (location = 4) in mat4 iInstance;
+
+mat4 modelMatrix()
+{
+	return iInstance * model;
+}
+#else
+mat4 modelMatrix()
+{
+	return model;
+}
+#endif
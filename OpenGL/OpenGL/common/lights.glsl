@@ -0,0 +1,161 @@
+// Material and light uniforms of the lit shaders. The defines pick the permutation, Shader passes them in:
+//   LIGHTING         0 outputs the unlit diffuse texture.
+//   DIR_LIGHT        1 adds dirLight.
+//   NR_POINT_LIGHTS  Size of pointLights, 0 drops them.
+//   SPOT_LIGHT       1 adds spotLight.
+//   SPECULAR_MAP     1 samples material.specular, 0 uses the constant material.specularColor.
+#include "frame_data.glsl"
+
+#ifndef LIGHTING
+#define LIGHTING 1
+#endif
+#ifndef DIR_LIGHT
+#define DIR_LIGHT 1
+#endif
+#ifndef NR_POINT_LIGHTS
+#define NR_POINT_LIGHTS 4
+#endif
+#ifndef SPOT_LIGHT
+#define SPOT_LIGHT 1
+#endif
+#ifndef SPECULAR_MAP
+#define SPECULAR_MAP 1
+#endif
+
+struct Material {
+	sampler2D diffuse;
+#if SPECULAR_MAP
+	sampler2D specular;
+#else
+	vec3 specularColor;
+#endif
+	float shininess;
+};
+
+struct DirLight {
+	vec3 direction;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+};
+
+struct PointLight {
+	vec3 position;
+
+	vec3 ambient;
+	vec3 diffuse;
+	vec3 specular;
+
+	float constant;
+	float linear;
+	float quadratic;
+};
+
+struct SpotLight {
+	PointLight basic;
+
+	vec3 direction;
+	// ǶȵֵǽǶȣԺܶͱȽ϶Ƕ෴
+	float cutOff;
+	float outerCutOff;
+};
+
+uniform Material material;
+#if DIR_LIGHT
+uniform DirLight dirLight;
+#endif
+#if NR_POINT_LIGHTS > 0
+uniform PointLight pointLights[NR_POINT_LIGHTS];
+#endif
+#if SPOT_LIGHT
+uniform SpotLight spotLight;
+#endif
+
+// Surface colours, sampled once per fragment and shared by all the lights.
+struct Surface {
+	vec3 diffuse;
+	vec3 specular;
+};
+
+Surface sampleSurface(vec2 texCoords)
+{
+	Surface surface;
+	surface.diffuse = vec3(texture(material.diffuse, texCoords));
+#if SPECULAR_MAP
+	surface.specular = vec3(texture(material.specular, texCoords));
+#else
+	surface.specular = material.specularColor;
+#endif
+	return surface;
+}
+
+vec3 calcDirLight(DirLight light, Surface surface, vec3 normal, vec3 viewDir)
+{
+	vec3 lightDir = normalize(-light.direction);
+	float diff = max(dot(normal, lightDir), 0.0);
+
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+
+	vec3 ambient = light.ambient * surface.diffuse;
+	vec3 diffuse = light.diffuse * diff * surface.diffuse;
+	vec3 specular = light.specular * spec * surface.specular;
+	return (ambient + diffuse + specular);
+}
+
+vec3 calcPointLight(PointLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 lightDir = normalize(light.position - fragPos);
+
+	float diff = max(dot(normal, lightDir), 0.0);
+
+	vec3 reflectDir = reflect(-lightDir, normal);
+	float spec = pow(max(dot(reflectDir, viewDir), 0.0), material.shininess);
+
+	float distance = length(light.position - fragPos);
+	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
+
+	vec3 ambient = light.ambient * surface.diffuse;
+	vec3 diffuse = light.diffuse * diff * surface.diffuse;
+	vec3 specular = light.specular * spec * surface.specular;
+
+	return (ambient + diffuse + specular) * attenuation;
+}
+
+vec3 calcSpotLight(SpotLight light, Surface surface, vec3 normal, vec3 fragPos, vec3 viewDir)
+{
+	vec3 lightDir = normalize(light.basic.position - fragPos);
+	float theta = dot(lightDir, normalize(-light.direction));
+	// Ҳֵ
+	float epsilon = light.cutOff - light.outerCutOff;
+	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
+
+	vec3 result = calcPointLight(light.basic, surface, normal, fragPos, viewDir);
+	// رԵ
+	return result * intensity;
+}
+
+// Colour of a fragment lit by every light this permutation has.
+vec3 calcLighting(vec3 normal, vec3 fragPos, vec2 texCoords)
+{
+	Surface surface = sampleSurface(texCoords);
+#if LIGHTING
+	vec3 viewDir = normalize(cameraPosition.xyz - fragPos);
+	vec3 result = vec3(0.0);
+#if DIR_LIGHT
+	result += calcDirLight(dirLight, surface, normal, viewDir);
+#endif
+#if NR_POINT_LIGHTS > 0
+	for (int i = 0; i < NR_POINT_LIGHTS; i++) {
+		result += calcPointLight(pointLights[i], surface, normal, fragPos, viewDir);
+	}
+#endif
+#if SPOT_LIGHT
+	result += calcSpotLight(spotLight, surface, normal, fragPos, viewDir);
+#endif
+	return result;
+#else
+	return surface.diffuse;
+#endif
+}
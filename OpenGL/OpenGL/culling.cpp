@@ -0,0 +1,256 @@
+#include "culling.h"
+
+#include <cmath>
+
+#if defined(__AVX__)
+#define CULLING_AVX 1
+#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define CULLING_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace {
+    // A box is outside when its corner furthest along the plane normal is behind the plane:
+    //     dot(n, center) + w + dot(|n|, extent) < 0
+    // The SIMD paths evaluate this for a whole register of boxes per plane.
+    struct PlaneTerms {
+        float nx, ny, nz, w;
+        float ax, ay, az;  // |n|
+    };
+
+    void planeTerms(const Culling::Frustum& frustum, PlaneTerms (&terms)[6])
+    {
+        for (int p = 0; p < 6; ++p) {
+            const glm::vec4& plane = frustum.planes[p];
+            terms[p] = {plane.x, plane.y, plane.z, plane.w, std::fabs(plane.x), std::fabs(plane.y),
+                        std::fabs(plane.z)};
+        }
+    }
+
+    bool boxVisible(const PlaneTerms (&terms)[6], const Culling::Boxes& boxes, size_t i)
+    {
+        for (const PlaneTerms& plane : terms) {
+            float distance = plane.nx * boxes.center_x[i] + plane.ny * boxes.center_y[i] +
+                             plane.nz * boxes.center_z[i] + plane.w;
+            float reach = plane.ax * boxes.extent_x[i] + plane.ay * boxes.extent_y[i] + plane.az * boxes.extent_z[i];
+            if (distance + reach < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Boxes from `first` on, one at a time.
+    size_t cullTail(const PlaneTerms (&terms)[6], const Culling::Boxes& boxes, size_t first, uint32_t* visible,
+                    size_t written)
+    {
+        for (size_t i = first; i < boxes.size(); ++i) {
+            visible[written] = static_cast<uint32_t>(i);
+            written += boxVisible(terms, boxes, i);
+        }
+        return written;
+    }
+}  // namespace
+
+namespace Culling {
+    Frustum extractFrustum(const glm::mat4& clip)
+    {
+        // Gribb & Hartmann: each plane is the last row of the matrix plus or minus one of the others.
+        glm::vec4 rows[4];
+        for (int i = 0; i < 4; ++i) {
+            rows[i] = glm::vec4(clip[0][i], clip[1][i], clip[2][i], clip[3][i]);
+        }
+        Frustum frustum;
+        frustum.planes[0] = rows[3] + rows[0];
+        frustum.planes[1] = rows[3] - rows[0];
+        frustum.planes[2] = rows[3] + rows[1];
+        frustum.planes[3] = rows[3] - rows[1];
+        frustum.planes[4] = rows[3] + rows[2];
+        frustum.planes[5] = rows[3] - rows[2];
+        for (glm::vec4& plane : frustum.planes) {
+            float length = glm::length(glm::vec3(plane));
+            if (length > 0.0f) {
+                plane /= length;
+            }
+        }
+        return frustum;
+    }
+
+    bool sphereVisible(const Frustum& frustum, const glm::vec3& center, float radius)
+    {
+        for (const glm::vec4& plane : frustum.planes) {
+            if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    Box transformBox(const Box& box, const glm::mat4& transform)
+    {
+        // Arvo: the new half extents are the old ones through the absolute value of the linear part.
+        Box result;
+        result.center = glm::vec3(transform * glm::vec4(box.center, 1.0f));
+        for (int row = 0; row < 3; ++row) {
+            result.extent[row] = std::fabs(transform[0][row]) * box.extent.x +
+                                 std::fabs(transform[1][row]) * box.extent.y +
+                                 std::fabs(transform[2][row]) * box.extent.z;
+        }
+        return result;
+    }
+
+    bool boxVisible(const Frustum& frustum, const Box& box)
+    {
+        for (const glm::vec4& plane : frustum.planes) {
+            glm::vec3 normal(plane);
+            if (glm::dot(normal, box.center) + plane.w + glm::dot(glm::abs(normal), box.extent) < 0.0f) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void Boxes::clear()
+    {
+        center_x.clear();
+        center_y.clear();
+        center_z.clear();
+        extent_x.clear();
+        extent_y.clear();
+        extent_z.clear();
+    }
+
+    void Boxes::add(const Box& box)
+    {
+        center_x.push_back(box.center.x);
+        center_y.push_back(box.center.y);
+        center_z.push_back(box.center.z);
+        extent_x.push_back(box.extent.x);
+        extent_y.push_back(box.extent.y);
+        extent_z.push_back(box.extent.z);
+    }
+
+    size_t cullBoxes(const Frustum& frustum, const Boxes& boxes, std::vector<uint32_t>& visible)
+    {
+        PlaneTerms terms[6];
+        planeTerms(frustum, terms);
+        size_t count = boxes.size();
+        // Every index is written and only kept when its box is visible, which avoids a branch per box.
+        visible.resize(count);
+        uint32_t* out = visible.data();
+        size_t written = 0;
+        size_t i = 0;
+#if CULLING_AVX
+        // Broadcast once, the loop reads them as memory operands.
+        __m256 planes[6][7];
+        for (int p = 0; p < 6; ++p) {
+            const PlaneTerms& t = terms[p];
+            const float values[7] = {t.nx, t.ny, t.nz, t.w, t.ax, t.ay, t.az};
+            for (int k = 0; k < 7; ++k) {
+                planes[p][k] = _mm256_set1_ps(values[k]);
+            }
+        }
+        const __m256 zero = _mm256_setzero_ps();
+        for (; i + 8 <= count; i += 8) {
+            __m256 cx = _mm256_loadu_ps(&boxes.center_x[i]);
+            __m256 cy = _mm256_loadu_ps(&boxes.center_y[i]);
+            __m256 cz = _mm256_loadu_ps(&boxes.center_z[i]);
+            __m256 ex = _mm256_loadu_ps(&boxes.extent_x[i]);
+            __m256 ey = _mm256_loadu_ps(&boxes.extent_y[i]);
+            __m256 ez = _mm256_loadu_ps(&boxes.extent_z[i]);
+            __m256 outside = zero;
+            for (const __m256(&plane)[7] : planes) {
+                __m256 distance = _mm256_add_ps(_mm256_mul_ps(plane[0], cx), plane[3]);
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane[1], cy));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane[2], cz));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane[4], ex));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane[5], ey));
+                distance = _mm256_add_ps(distance, _mm256_mul_ps(plane[6], ez));
+                outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, zero, _CMP_LT_OQ));
+            }
+            int inside = ~_mm256_movemask_ps(outside);
+            for (int lane = 0; lane < 8; ++lane) {
+                out[written] = static_cast<uint32_t>(i + lane);
+                written += (inside >> lane) & 1;
+            }
+        }
+#elif CULLING_SSE
+        __m128 planes[6][7];
+        for (int p = 0; p < 6; ++p) {
+            const PlaneTerms& t = terms[p];
+            const float values[7] = {t.nx, t.ny, t.nz, t.w, t.ax, t.ay, t.az};
+            for (int k = 0; k < 7; ++k) {
+                planes[p][k] = _mm_set1_ps(values[k]);
+            }
+        }
+        const __m128 zero = _mm_setzero_ps();
+        for (; i + 4 <= count; i += 4) {
+            __m128 cx = _mm_loadu_ps(&boxes.center_x[i]);
+            __m128 cy = _mm_loadu_ps(&boxes.center_y[i]);
+            __m128 cz = _mm_loadu_ps(&boxes.center_z[i]);
+            __m128 ex = _mm_loadu_ps(&boxes.extent_x[i]);
+            __m128 ey = _mm_loadu_ps(&boxes.extent_y[i]);
+            __m128 ez = _mm_loadu_ps(&boxes.extent_z[i]);
+            __m128 outside = zero;
+            for (const __m128(&plane)[7] : planes) {
+                __m128 distance = _mm_add_ps(_mm_mul_ps(plane[0], cx), plane[3]);
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane[1], cy));
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane[2], cz));
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane[4], ex));
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane[5], ey));
+                distance = _mm_add_ps(distance, _mm_mul_ps(plane[6], ez));
+                outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, zero));
+            }
+            int inside = ~_mm_movemask_ps(outside);
+            for (int lane = 0; lane < 4; ++lane) {
+                out[written] = static_cast<uint32_t>(i + lane);
+                written += (inside >> lane) & 1;
+            }
+        }
+#endif
+        written = cullTail(terms, boxes, i, out, written);
+        visible.resize(written);
+        return written;
+    }
+
+    size_t cullBoxesScalar(const Frustum& frustum, const Boxes& boxes, std::vector<uint32_t>& visible)
+    {
+        PlaneTerms terms[6];
+        planeTerms(frustum, terms);
+        visible.resize(boxes.size());
+        size_t written = cullTail(terms, boxes, 0, visible.data(), 0);
+        visible.resize(written);
+        return written;
+    }
+
+    const char* simdName()
+    {
+#if CULLING_AVX
+        return "AVX";
+#elif CULLING_SSE
+        return "SSE";
+#else
+        return "scalar";
+#endif
+    }
+
+    bool coneBackfacing(const glm::vec3& apex, const glm::vec3& axis, float cutoff, const glm::vec3& eye)
+    {
+        glm::vec3 view = apex - eye;
+        float length = glm::length(view);
+        return length > 0.0f && glm::dot(view, axis) >= cutoff * length;
+    }
+
+    void Stats::add(const Stats& other)
+    {
+        clusters += other.clusters;
+        frustum_culled += other.frustum_culled;
+        backface_culled += other.backface_culled;
+        triangles += other.triangles;
+        triangles_drawn += other.triangles_drawn;
+        draw_calls += other.draw_calls;
+        objects += other.objects;
+        objects_culled += other.objects_culled;
+    }
+}  // namespace Culling
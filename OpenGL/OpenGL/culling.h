@@ -0,0 +1,78 @@
+#pragma once
+#ifndef CULLING_H
+#define CULLING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm.hpp>
+
+// Visibility tests run on the CPU before draws are submitted.
+namespace Culling {
+    // Planes as (normal, distance) with unit normals pointing inside: left, right, bottom, top, near, far.
+    struct Frustum {
+        glm::vec4 planes[6];
+    };
+
+    // Frustum of a model-view-projection matrix, expressed in the space that matrix transforms from.
+    Frustum extractFrustum(const glm::mat4& clip);
+    bool sphereVisible(const Frustum& frustum, const glm::vec3& center, float radius);
+    // True when every triangle under the normal cone faces away from `eye`. A cutoff of 1 never culls.
+    bool coneBackfacing(const glm::vec3& apex, const glm::vec3& axis, float cutoff, const glm::vec3& eye);
+
+    // Axis-aligned box as center and half extents.
+    struct Box {
+        glm::vec3 center = glm::vec3(0.0f);
+        glm::vec3 extent = glm::vec3(0.0f);
+    };
+
+    // Box enclosing `box` after `transform`.
+    Box transformBox(const Box& box, const glm::mat4& transform);
+    bool boxVisible(const Frustum& frustum, const Box& box);
+
+    // Many boxes, one array per component, so the batched test loads four (SSE) or eight (AVX) of them at once.
+    struct Boxes {
+        std::vector<float> center_x;
+        std::vector<float> center_y;
+        std::vector<float> center_z;
+        std::vector<float> extent_x;
+        std::vector<float> extent_y;
+        std::vector<float> extent_z;
+
+        size_t size() const { return center_x.size(); }
+        // Keeps the capacity, so refilling every frame doesn't allocate.
+        void clear();
+        void add(const Box& box);
+        void add(const Box& box, const glm::mat4& transform) { add(transformBox(box, transform)); }
+    };
+
+    // Writes the indices of the boxes that are at least partly inside `frustum` to `visible`, in order, and returns
+    // their count. Uses the widest SIMD instruction set the build targets, see simdName().
+    size_t cullBoxes(const Frustum& frustum, const Boxes& boxes, std::vector<uint32_t>& visible);
+    // The same one box at a time, as reference.
+    size_t cullBoxesScalar(const Frustum& frustum, const Boxes& boxes, std::vector<uint32_t>& visible);
+    // "AVX", "SSE" or "scalar".
+    const char* simdName();
+
+    // What a draw is culled against, in the space of the geometry.
+    struct View {
+        Frustum frustum;
+        glm::vec3 eye;
+    };
+
+    struct Stats {
+        size_t clusters = 0;
+        size_t frustum_culled = 0;   // Clusters.
+        size_t backface_culled = 0;  // Clusters.
+        size_t triangles = 0;        // Of the selected levels, before culling.
+        size_t triangles_drawn = 0;
+        size_t draw_calls = 0;
+        size_t objects = 0;          // Meshes and instances tested as boxes.
+        size_t objects_culled = 0;
+
+        void add(const Stats& other);
+    };
+}  // namespace Culling
+
+#endif
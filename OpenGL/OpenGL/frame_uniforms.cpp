@@ -0,0 +1,41 @@
+#include "frame_uniforms.h"
+
+const char* const FrameUniforms::BLOCK_NAME = "FrameData";
+
+FrameUniforms& FrameUniforms::shared()
+{
+    // Never destroyed, it owns GL objects, see GlHandle.
+    static FrameUniforms* uniforms = new FrameUniforms();
+    return *uniforms;
+}
+
+FrameUniforms::FrameUniforms()
+{
+    buffer_ = GlBuffer::create();
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_.get());
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameData), &data_, GL_DYNAMIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, BINDING, buffer_.get());
+}
+
+void FrameUniforms::update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camera_position,
+                           float time)
+{
+    glm::vec4 position(camera_position, 1.0f);
+    bool camera_changed = view != data_.view || projection != data_.projection || position != data_.camera_position;
+    if (!camera_changed && time == data_.time) {
+        return;
+    }
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer_.get());
+    data_.time = time;
+    if (camera_changed) {
+        data_.view = view;
+        data_.projection = projection;
+        data_.view_projection = projection * view;
+        data_.camera_position = position;
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameData), &data_);
+    } else {
+        glBufferSubData(GL_UNIFORM_BUFFER, offsetof(FrameData, time), sizeof(float), &data_.time);
+    }
+    ++uploads_;
+}
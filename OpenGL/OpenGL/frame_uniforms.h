@@ -0,0 +1,54 @@
+#pragma once
+#ifndef FRAME_UNIFORMS_H
+#define FRAME_UNIFORMS_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include "gl_handle.h"
+
+// CPU side of the FrameData uniform block in std140 layout. The shaders declare it as
+//     layout (std140) uniform FrameData {
+//         mat4 view;
+//         mat4 projection;
+//         mat4 viewProjection;
+//         vec4 cameraPosition;
+//         float time;
+//     };
+struct FrameData {
+    glm::mat4 view = glm::mat4(1.0f);
+    glm::mat4 projection = glm::mat4(1.0f);
+    glm::mat4 view_projection = glm::mat4(1.0f);
+    glm::vec4 camera_position = glm::vec4(0.0f);  // w unused.
+    float time = 0.0f;
+    float padding[3] = {};
+};
+static_assert(sizeof(FrameData) == 224, "FrameData has to match the std140 layout of the block");
+
+// The uniform buffer holding FrameData, shared by every shader. Shader binds the block of each program it links to
+// BINDING, so a frame updates the camera once instead of setting view and projection on every program.
+// Needs a current GL context.
+class FrameUniforms {
+public:
+    static const GLuint BINDING = 0;
+    static const char* const BLOCK_NAME;
+
+    static FrameUniforms& shared();
+
+    // Uploads the camera part only when it differs from the last upload, and the time when it changed.
+    void update(const glm::mat4& view, const glm::mat4& projection, const glm::vec3& camera_position, float time);
+    const FrameData& data() const { return data_; }
+    // Buffer updates so far.
+    size_t uploads() const { return uploads_; }
+
+private:
+    FrameUniforms();
+
+    GlBuffer buffer_;
+    FrameData data_;
+    size_t uploads_ = 0;
+};
+
+#endif
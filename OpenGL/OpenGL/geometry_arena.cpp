@@ -0,0 +1,309 @@
+#include "geometry_arena.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+namespace {
+    const size_t INITIAL_VERTICES = 1 << 16;
+    const size_t INITIAL_INDICES = 1 << 19;
+
+    float fragmentation(const RangeAllocator& allocator)
+    {
+        size_t free_space = allocator.capacity() - allocator.used();
+        return free_space == 0 ? 0.0f : 1.0f - float(allocator.largestFreeBlock()) / float(free_space);
+    }
+
+    size_t grownCapacity(size_t capacity, size_t needed)
+    {
+        while (capacity < needed) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+}  // namespace
+
+RangeAllocator::RangeAllocator(size_t capacity)
+{
+    reset(capacity, 0);
+}
+
+bool RangeAllocator::allocate(size_t size, size_t& offset)
+{
+    if (size == 0) {
+        offset = 0;
+        return true;
+    }
+    for (auto it = free_blocks_.begin(); it != free_blocks_.end(); ++it) {
+        if (it->second >= size) {
+            offset = it->first;
+            size_t left = it->second - size;
+            free_blocks_.erase(it);
+            if (left != 0) {
+                free_blocks_[offset + size] = left;
+            }
+            used_ += size;
+            return true;
+        }
+    }
+    return false;
+}
+
+void RangeAllocator::free(size_t offset, size_t size)
+{
+    if (size == 0) {
+        return;
+    }
+    used_ -= size;
+    auto next = free_blocks_.lower_bound(offset);
+    // Merge with the block after.
+    if (next != free_blocks_.end() && offset + size == next->first) {
+        size += next->second;
+        next = free_blocks_.erase(next);
+    }
+    // Merge with the block before.
+    if (next != free_blocks_.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+    free_blocks_[offset] = size;
+}
+
+void RangeAllocator::grow(size_t capacity)
+{
+    size_t old_capacity = capacity_;
+    capacity_ = capacity;
+    used_ += capacity - old_capacity;
+    free(old_capacity, capacity - old_capacity);
+}
+
+void RangeAllocator::reset(size_t capacity, size_t used)
+{
+    free_blocks_.clear();
+    capacity_ = capacity;
+    used_ = used;
+    if (used < capacity) {
+        free_blocks_[used] = capacity - used;
+    }
+}
+
+size_t RangeAllocator::largestFreeBlock() const
+{
+    size_t largest = 0;
+    for (const auto& block : free_blocks_) {
+        largest = std::max(largest, block.second);
+    }
+    return largest;
+}
+
+GeometryArena& GeometryArena::shared(VertexFormat format)
+{
+    // Never destroyed, it owns GL objects, see GlHandle.
+    static GeometryArena* full = new GeometryArena(VertexFormat::FLOAT);
+    static GeometryArena* half = new GeometryArena(VertexFormat::HALF);
+    static GeometryArena* unorm16 = new GeometryArena(VertexFormat::UNORM16);
+    switch (format) {
+    case VertexFormat::HALF:
+        return *half;
+    case VertexFormat::UNORM16:
+        return *unorm16;
+    default:
+        return *full;
+    }
+}
+
+GeometryArena::Handle GeometryArena::allocate(const void* vertices, size_t vertex_count,
+                                              const uint16_t* indices, size_t index_count)
+{
+    if (!vao_) {
+        create(grownCapacity(INITIAL_VERTICES, vertex_count), grownCapacity(INITIAL_INDICES, index_count));
+    }
+
+    size_t base_vertex = 0;
+    size_t first_index = 0;
+    if (!vertices_.allocate(vertex_count, base_vertex)) {
+        size_t capacity = grownCapacity(vertices_.capacity() * 2, vertices_.capacity() + vertex_count);
+        reallocate(capacity, indices_.capacity(), ranges_);
+        vertices_.grow(capacity);
+        vertices_.allocate(vertex_count, base_vertex);
+    }
+    if (!indices_.allocate(index_count, first_index)) {
+        size_t capacity = grownCapacity(indices_.capacity() * 2, indices_.capacity() + index_count);
+        reallocate(vertices_.capacity(), capacity, ranges_);
+        indices_.grow(capacity);
+        indices_.allocate(index_count, first_index);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_.get());
+    glBufferSubData(GL_ARRAY_BUFFER, base_vertex * stride_, vertex_count * stride_, vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo_.get());
+    glBufferSubData(GL_COPY_WRITE_BUFFER, first_index * sizeof(uint16_t), index_count * sizeof(uint16_t), indices);
+
+    Range range;
+    range.base_vertex = static_cast<uint32_t>(base_vertex);
+    range.vertex_count = static_cast<uint32_t>(vertex_count);
+    range.first_index = static_cast<uint32_t>(first_index);
+    range.index_count = static_cast<uint32_t>(index_count);
+
+    Handle handle;
+    if (!free_handles_.empty()) {
+        handle = free_handles_.back();
+        free_handles_.pop_back();
+        ranges_[handle] = range;
+        live_[handle] = true;
+    } else {
+        handle = static_cast<Handle>(ranges_.size());
+        ranges_.push_back(range);
+        live_.push_back(true);
+    }
+    return handle;
+}
+
+void GeometryArena::free(Handle handle)
+{
+    if (handle == INVALID_HANDLE || !live_[handle]) {
+        return;
+    }
+    const Range& range = ranges_[handle];
+    vertices_.free(range.base_vertex, range.vertex_count);
+    indices_.free(range.first_index, range.index_count);
+    ranges_[handle] = Range();
+    live_[handle] = false;
+    free_handles_.push_back(handle);
+}
+
+void GeometryArena::bind()
+{
+    GlState::shared().bindVertexArray(vao_.get());
+}
+
+void GeometryArena::draw(Handle handle, const IndexBuffer::Chunk& chunk)
+{
+    const Range& range = ranges_[handle];
+    glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(chunk.index_count), GL_UNSIGNED_SHORT,
+                             (void*)((range.first_index + chunk.first_index) * sizeof(uint16_t)),
+                             static_cast<GLint>(range.base_vertex + chunk.base_vertex));
+}
+
+void GeometryArena::drawInstanced(Handle handle, const IndexBuffer::Chunk& chunk, GLsizei instance_count)
+{
+    const Range& range = ranges_[handle];
+    glDrawElementsInstancedBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(chunk.index_count), GL_UNSIGNED_SHORT,
+                                      (void*)((range.first_index + chunk.first_index) * sizeof(uint16_t)),
+                                      instance_count, static_cast<GLint>(range.base_vertex + chunk.base_vertex));
+}
+
+size_t GeometryArena::defragment()
+{
+    if (!vao_) {
+        return 0;
+    }
+
+    // Pack in the current order so the relative layout, and with it locality, is kept.
+    std::vector<Handle> order;
+    for (Handle handle = 0; handle < ranges_.size(); ++handle) {
+        if (live_[handle]) {
+            order.push_back(handle);
+        }
+    }
+    std::sort(order.begin(), order.end(),
+              [this](Handle a, Handle b) { return ranges_[a].base_vertex < ranges_[b].base_vertex; });
+
+    std::vector<Range> packed = ranges_;
+    uint32_t vertex_end = 0;
+    uint32_t index_end = 0;
+    for (Handle handle : order) {
+        packed[handle].base_vertex = vertex_end;
+        packed[handle].first_index = index_end;
+        vertex_end += packed[handle].vertex_count;
+        index_end += packed[handle].index_count;
+    }
+
+    size_t moved = reallocate(vertices_.capacity(), indices_.capacity(), packed);
+    ranges_ = packed;
+    vertices_.reset(vertices_.capacity(), vertex_end);
+    indices_.reset(indices_.capacity(), index_end);
+    return moved;
+}
+
+GeometryArena::Stats GeometryArena::stats() const
+{
+    Stats stats;
+    stats.allocations = ranges_.size() - free_handles_.size();
+    stats.vertex_capacity = vertices_.capacity();
+    stats.vertex_used = vertices_.used();
+    stats.index_capacity = indices_.capacity();
+    stats.index_used = indices_.used();
+    stats.free_blocks = vertices_.freeBlockCount() + indices_.freeBlockCount();
+    stats.vertex_fragmentation = fragmentation(vertices_);
+    stats.index_fragmentation = fragmentation(indices_);
+    stats.bytes = vertices_.capacity() * stride_ + indices_.capacity() * sizeof(uint16_t);
+    return stats;
+}
+
+void GeometryArena::create(size_t vertex_capacity, size_t index_capacity)
+{
+    vao_ = GlVertexArray::create();
+    vbo_ = GlBuffer::create();
+    ebo_ = GlBuffer::create();
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_.get());
+    glBufferData(GL_ARRAY_BUFFER, vertex_capacity * stride_, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, ebo_.get());
+    glBufferData(GL_COPY_WRITE_BUFFER, index_capacity * sizeof(uint16_t), nullptr, GL_STATIC_DRAW);
+    vertices_.reset(vertex_capacity, 0);
+    indices_.reset(index_capacity, 0);
+    setupVertexArray();
+}
+
+size_t GeometryArena::reallocate(size_t vertex_capacity, size_t index_capacity, const std::vector<Range>& ranges)
+{
+    GlBuffer vertex_buffer = GlBuffer::create();
+    GlBuffer index_buffer = GlBuffer::create();
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer.get());
+    glBufferData(GL_COPY_WRITE_BUFFER, vertex_capacity * stride_, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer.get());
+    glBufferData(GL_COPY_WRITE_BUFFER, index_capacity * sizeof(uint16_t), nullptr, GL_STATIC_DRAW);
+
+    // Copy every live range, GPU to GPU.
+    size_t moved = 0;
+    for (Handle handle = 0; handle < ranges_.size(); ++handle) {
+        if (!live_[handle]) {
+            continue;
+        }
+        const Range& from = ranges_[handle];
+        const Range& to = ranges[handle];
+        glBindBuffer(GL_COPY_READ_BUFFER, vbo_.get());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer.get());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from.base_vertex * stride_,
+                            to.base_vertex * stride_, from.vertex_count * stride_);
+        glBindBuffer(GL_COPY_READ_BUFFER, ebo_.get());
+        glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer.get());
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, from.first_index * sizeof(uint16_t),
+                            to.first_index * sizeof(uint16_t), from.index_count * sizeof(uint16_t));
+        moved += from.vertex_count * stride_ + from.index_count * sizeof(uint16_t);
+    }
+
+    // Moving in deletes the old buffers.
+    vbo_ = std::move(vertex_buffer);
+    ebo_ = std::move(index_buffer);
+    setupVertexArray();
+    return moved;
+}
+
+void GeometryArena::setupVertexArray()
+{
+    GlState::shared().bindVertexArray(vao_.get());
+    glBindBuffer(GL_ARRAY_BUFFER, vbo_.get());
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo_.get());
+
+    setupVertexAttributes(format_);
+
+    GlState::shared().bindVertexArray(0);
+}
@@ -0,0 +1,145 @@
+#pragma once
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "gl_handle.h"
+#include "index_buffer.h"
+#include "vertex_format.h"
+
+// First-fit free list over a range of elements, neighbouring free blocks are merged on free.
+class RangeAllocator {
+public:
+    explicit RangeAllocator(size_t capacity = 0);
+
+    bool allocate(size_t size, size_t& offset);
+    void free(size_t offset, size_t size);
+    // Appends the new space as a free block.
+    void grow(size_t capacity);
+    // Everything below `used` is taken, the rest is one free block.
+    void reset(size_t capacity, size_t used);
+
+    size_t capacity() const { return capacity_; }
+    size_t used() const { return used_; }
+    size_t freeBlockCount() const { return free_blocks_.size(); }
+    size_t largestFreeBlock() const;
+
+private:
+    std::map<size_t, size_t> free_blocks_;  // Offset -> size.
+    size_t capacity_ = 0;
+    size_t used_ = 0;
+};
+
+// One vertex buffer and one index buffer shared by every Mesh with the same VertexFormat, behind a single VAO.
+// Meshes hold a handle, not offsets, so defragment() can move their ranges. Indices are 16 bit and relative to their
+// chunk, draws add the chunk's base vertex. Buffers double when a request doesn't fit.
+// Must only be used on the GL thread.
+class GeometryArena {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+
+    struct Range {
+        uint32_t base_vertex = 0;
+        uint32_t vertex_count = 0;
+        uint32_t first_index = 0;
+        uint32_t index_count = 0;
+    };
+
+    struct Stats {
+        size_t allocations = 0;
+        size_t vertex_capacity = 0;
+        size_t vertex_used = 0;
+        size_t index_capacity = 0;
+        size_t index_used = 0;
+        size_t free_blocks = 0;
+        // 1 - largest free block / free space, 0 when the free space is contiguous.
+        float vertex_fragmentation = 0.0f;
+        float index_fragmentation = 0.0f;
+        size_t bytes = 0;  // GPU memory of both buffers.
+    };
+
+    // One arena per format, their GL objects live as long as the context.
+    static GeometryArena& shared(VertexFormat format = VertexFormat::FLOAT);
+
+    GeometryArena(const GeometryArena&) = delete;
+    GeometryArena& operator=(const GeometryArena&) = delete;
+
+    // `vertices` are in the arena's format.
+    Handle allocate(const void* vertices, size_t vertex_count, const uint16_t* indices, size_t index_count);
+    void free(Handle handle);
+    const Range& range(Handle handle) const { return ranges_[handle]; }
+
+    // Binds the shared VAO through GlState. It stays bound after the draws like any other vertex array, so code
+    // that changes vertex array state (element buffer binding, attribute pointers) has to bind its own VAO first,
+    // or it edits the arena's for every mesh.
+    void bind();
+    void draw(Handle handle, const IndexBuffer::Chunk& chunk);
+    // Draws the chunk `instance_count` times, the caller attaches the per-instance attributes.
+    void drawInstanced(Handle handle, const IndexBuffer::Chunk& chunk, GLsizei instance_count);
+    // Packs the live ranges to the front of the buffers, returns the number of bytes moved.
+    size_t defragment();
+    Stats stats() const;
+
+private:
+    explicit GeometryArena(VertexFormat format) : format_(format), stride_(vertexStride(format)) {}
+    void create(size_t vertex_capacity, size_t index_capacity);
+    // Moves the contents into buffers of the new capacities, `ranges` says where each live range goes.
+    size_t reallocate(size_t vertex_capacity, size_t index_capacity, const std::vector<Range>& ranges);
+    void setupVertexArray();
+
+    VertexFormat format_;
+    size_t stride_;
+    GlVertexArray vao_;
+    GlBuffer vbo_;
+    GlBuffer ebo_;
+    RangeAllocator vertices_;
+    RangeAllocator indices_;
+    std::vector<Range> ranges_;  // By handle.
+    std::vector<bool> live_;
+    std::vector<Handle> free_handles_;
+};
+
+// Move-only owner of one arena range, freed when the owner dies, like GlHandle for GL objects.
+class GeometryAllocation {
+public:
+    GeometryAllocation() = default;
+    GeometryAllocation(GeometryArena& arena, GeometryArena::Handle handle) : arena_(&arena), handle_(handle) {}
+    ~GeometryAllocation() { reset(); }
+
+    GeometryAllocation(GeometryAllocation&& other) noexcept
+        : arena_(other.arena_), handle_(std::exchange(other.handle_, GeometryArena::INVALID_HANDLE))
+    {
+    }
+    GeometryAllocation& operator=(GeometryAllocation&& other) noexcept
+    {
+        if (this != &other) {
+            reset();
+            arena_ = other.arena_;
+            handle_ = std::exchange(other.handle_, GeometryArena::INVALID_HANDLE);
+        }
+        return *this;
+    }
+    GeometryAllocation(const GeometryAllocation&) = delete;
+    GeometryAllocation& operator=(const GeometryAllocation&) = delete;
+
+    GeometryArena::Handle handle() const { return handle_; }
+    void reset()
+    {
+        if (handle_ != GeometryArena::INVALID_HANDLE) {
+            arena_->free(handle_);
+            handle_ = GeometryArena::INVALID_HANDLE;
+        }
+    }
+
+private:
+    GeometryArena* arena_ = nullptr;
+    GeometryArena::Handle handle_ = GeometryArena::INVALID_HANDLE;
+};
+
+#endif
@@ -7,8 +7,7 @@ out vec2 texCoord;
 uniform mat4 transform;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "../common/frame_data.glsl"
 
 void main()
 {
@@ -0,0 +1,112 @@
+#pragma once
+#ifndef GL_HANDLE_H
+#define GL_HANDLE_H
+
+#include <utility>
+
+#include <glad/glad.h>
+
+#include "gl_state.h"
+
+// Move-only owner of a GL object name, deleting it when the handle dies. Handles have to be destroyed on the GL
+// thread while the context is current, like any other GL call. That rules out static storage: static destructors
+// run after the context is gone, so singletons holding handles are allocated once and never destroyed.
+template <typename Traits>
+class GlHandle {
+public:
+    GlHandle() = default;
+    explicit GlHandle(GLuint id) : id_(id) {}
+    ~GlHandle() { reset(); }
+
+    GlHandle(GlHandle&& other) noexcept : id_(other.release()) {}
+    GlHandle& operator=(GlHandle&& other) noexcept
+    {
+        if (this != &other) {
+            reset(other.release());
+        }
+        return *this;
+    }
+    GlHandle(const GlHandle&) = delete;
+    GlHandle& operator=(const GlHandle&) = delete;
+
+    // Generates a new object of the kind.
+    static GlHandle create() { return GlHandle(Traits::create()); }
+
+    GLuint get() const { return id_; }
+    explicit operator bool() const { return id_ != 0; }
+
+    // Gives up ownership without deleting.
+    GLuint release() { return std::exchange(id_, 0); }
+    void reset(GLuint id = 0)
+    {
+        if (id_ != 0) {
+            Traits::destroy(id_);
+        }
+        id_ = id;
+    }
+
+private:
+    GLuint id_ = 0;
+};
+
+namespace GlHandleTraits {
+    struct Buffer {
+        static GLuint create()
+        {
+            GLuint id = 0;
+            glGenBuffers(1, &id);
+            return id;
+        }
+        static void destroy(GLuint id) { glDeleteBuffers(1, &id); }
+    };
+
+    struct VertexArray {
+        static GLuint create()
+        {
+            GLuint id = 0;
+            glGenVertexArrays(1, &id);
+            return id;
+        }
+        static void destroy(GLuint id)
+        {
+            GlState::shared().forgetVertexArray(id);
+            glDeleteVertexArrays(1, &id);
+        }
+    };
+
+    struct Texture {
+        static GLuint create()
+        {
+            GLuint id = 0;
+            glGenTextures(1, &id);
+            return id;
+        }
+        static void destroy(GLuint id)
+        {
+            GlState::shared().forgetTexture(id);
+            glDeleteTextures(1, &id);
+        }
+    };
+
+    struct Program {
+        static GLuint create() { return glCreateProgram(); }
+        static void destroy(GLuint id)
+        {
+            GlState::shared().forgetProgram(id);
+            glDeleteProgram(id);
+        }
+    };
+
+    // Shader stages have a type, so they are wrapped with GlShader(glCreateShader(type)) instead of create().
+    struct Shader {
+        static void destroy(GLuint id) { glDeleteShader(id); }
+    };
+}  // namespace GlHandleTraits
+
+using GlBuffer = GlHandle<GlHandleTraits::Buffer>;
+using GlVertexArray = GlHandle<GlHandleTraits::VertexArray>;
+using GlTexture = GlHandle<GlHandleTraits::Texture>;
+using GlProgram = GlHandle<GlHandleTraits::Program>;
+using GlShader = GlHandle<GlHandleTraits::Shader>;
+
+#endif
@@ -0,0 +1,213 @@
+#include "gl_state.h"
+
+namespace {
+    // Index into the tracked targets, -1 for the others.
+    int textureTarget(GLenum target)
+    {
+        switch (target) {
+        case GL_TEXTURE_2D:
+            return 0;
+        case GL_TEXTURE_CUBE_MAP:
+            return 1;
+        default:
+            return -1;
+        }
+    }
+}  // namespace
+
+GlState& GlState::shared()
+{
+    // Never destroyed: GlHandle destructors may still report deletions while statics are torn down.
+    static GlState* state = new GlState();
+    return *state;
+}
+
+GlState::GlState()
+{
+    invalidate();
+}
+
+bool GlState::track(bool changed)
+{
+    if (changed) {
+        ++frame_.calls;
+    } else {
+        ++frame_.redundant;
+    }
+    return changed;
+}
+
+void GlState::useProgram(GLuint program)
+{
+    if (track(program != program_)) {
+        glUseProgram(program);
+        program_ = program;
+    }
+}
+
+void GlState::bindVertexArray(GLuint vertex_array)
+{
+    if (track(vertex_array != vertex_array_)) {
+        glBindVertexArray(vertex_array);
+        vertex_array_ = vertex_array;
+    }
+}
+
+void GlState::activeTexture(GLenum unit)
+{
+    GLuint index = unit - GL_TEXTURE0;
+    if (track(index != active_unit_)) {
+        glActiveTexture(unit);
+        active_unit_ = index;
+    }
+}
+
+void GlState::bindTexture(GLenum target, GLuint texture)
+{
+    int index = textureTarget(target);
+    if (index < 0 || active_unit_ >= TEXTURE_UNITS) {
+        track(true);
+        glBindTexture(target, texture);
+        return;
+    }
+    GLuint& bound = textures_[index][active_unit_];
+    if (track(texture != bound)) {
+        glBindTexture(target, texture);
+        bound = texture;
+    }
+}
+
+void GlState::bindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+    int index = textureTarget(target);
+    if (index >= 0 && unit < TEXTURE_UNITS && textures_[index][unit] == texture) {
+        track(false);
+        return;
+    }
+    activeTexture(GL_TEXTURE0 + unit);
+    bindTexture(target, texture);
+}
+
+void GlState::apply(const PipelineState& state)
+{
+    applyDepth(state.depth());
+    applyStencil(state.stencil());
+    applyBlend(state.blend());
+    applyCull(state.cull());
+    pipeline_known_ = true;
+}
+
+void GlState::setCapability(GLenum capability, bool enabled, bool& current)
+{
+    if (track(!pipeline_known_ || enabled != current)) {
+        if (enabled) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+        current = enabled;
+    }
+}
+
+void GlState::applyDepth(const DepthState& depth)
+{
+    DepthState& current = pipeline_.depth;
+    setCapability(GL_DEPTH_TEST, depth.test, current.test);
+    if (track(!pipeline_known_ || depth.write != current.write)) {
+        glDepthMask(depth.write ? GL_TRUE : GL_FALSE);
+        current.write = depth.write;
+    }
+    if (track(!pipeline_known_ || depth.func != current.func)) {
+        glDepthFunc(depth.func);
+        current.func = depth.func;
+    }
+}
+
+void GlState::applyStencil(const StencilState& stencil)
+{
+    StencilState& current = pipeline_.stencil;
+    setCapability(GL_STENCIL_TEST, stencil.test, current.test);
+    if (track(!pipeline_known_ || stencil.func != current.func || stencil.ref != current.ref ||
+              stencil.read_mask != current.read_mask)) {
+        glStencilFunc(stencil.func, stencil.ref, stencil.read_mask);
+        current.func = stencil.func;
+        current.ref = stencil.ref;
+        current.read_mask = stencil.read_mask;
+    }
+    if (track(!pipeline_known_ || stencil.write_mask != current.write_mask)) {
+        glStencilMask(stencil.write_mask);
+        current.write_mask = stencil.write_mask;
+    }
+    if (track(!pipeline_known_ || stencil.stencil_fail != current.stencil_fail ||
+              stencil.depth_fail != current.depth_fail || stencil.depth_pass != current.depth_pass)) {
+        glStencilOp(stencil.stencil_fail, stencil.depth_fail, stencil.depth_pass);
+        current.stencil_fail = stencil.stencil_fail;
+        current.depth_fail = stencil.depth_fail;
+        current.depth_pass = stencil.depth_pass;
+    }
+}
+
+void GlState::applyBlend(const BlendState& blend)
+{
+    BlendState& current = pipeline_.blend;
+    setCapability(GL_BLEND, blend.enabled, current.enabled);
+    if (track(!pipeline_known_ || blend.src != current.src || blend.dst != current.dst)) {
+        glBlendFunc(blend.src, blend.dst);
+        current.src = blend.src;
+        current.dst = blend.dst;
+    }
+}
+
+void GlState::applyCull(const CullState& cull)
+{
+    CullState& current = pipeline_.cull;
+    setCapability(GL_CULL_FACE, cull.enabled, current.enabled);
+    if (track(!pipeline_known_ || cull.face != current.face)) {
+        glCullFace(cull.face);
+        current.face = cull.face;
+    }
+}
+
+void GlState::forgetProgram(GLuint program)
+{
+    if (program_ == program) {
+        program_ = UNKNOWN;
+    }
+}
+
+void GlState::forgetVertexArray(GLuint vertex_array)
+{
+    if (vertex_array_ == vertex_array) {
+        vertex_array_ = UNKNOWN;
+    }
+}
+
+void GlState::forgetTexture(GLuint texture)
+{
+    for (auto& units : textures_) {
+        for (GLuint& bound : units) {
+            if (bound == texture) {
+                bound = UNKNOWN;
+            }
+        }
+    }
+}
+
+void GlState::invalidate()
+{
+    program_ = UNKNOWN;
+    vertex_array_ = UNKNOWN;
+    active_unit_ = UNKNOWN;
+    for (auto& units : textures_) {
+        for (GLuint& bound : units) {
+            bound = UNKNOWN;
+        }
+    }
+    pipeline_known_ = false;
+}
+
+void GlState::endFrame()
+{
+    last_frame_ = frame_;
+    frame_ = FrameStats();
+}
@@ -0,0 +1,122 @@
+#pragma once
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include <cstddef>
+
+#include <glad/glad.h>
+
+// Fixed-function state of a pass. The defaults are GL's initial values.
+struct DepthState {
+    bool test = false;
+    bool write = true;
+    GLenum func = GL_LESS;
+};
+
+struct StencilState {
+    bool test = false;
+    GLenum func = GL_ALWAYS;
+    GLint ref = 0;
+    GLuint read_mask = 0xFF;
+    GLuint write_mask = 0xFF;
+    GLenum stencil_fail = GL_KEEP;
+    GLenum depth_fail = GL_KEEP;
+    GLenum depth_pass = GL_KEEP;
+};
+
+struct BlendState {
+    bool enabled = false;
+    GLenum src = GL_ONE;
+    GLenum dst = GL_ZERO;
+};
+
+struct CullState {
+    bool enabled = false;
+    GLenum face = GL_BACK;
+};
+
+// Immutable depth, stencil, blend and cull state, built once at setup and applied per pass with GlState::apply.
+class PipelineState {
+public:
+    struct Desc {
+        DepthState depth;
+        StencilState stencil;
+        BlendState blend;
+        CullState cull;
+    };
+
+    explicit PipelineState(const Desc& desc) : desc_(desc) {}
+
+    const DepthState& depth() const { return desc_.depth; }
+    const StencilState& stencil() const { return desc_.stencil; }
+    const BlendState& blend() const { return desc_.blend; }
+    const CullState& cull() const { return desc_.cull; }
+
+private:
+    Desc desc_;
+};
+
+// Shadow copy of the GL state the renderer changes: bound program, vertex array, textures per unit and the
+// pipeline state. Calls that wouldn't change anything are counted and dropped instead of reaching the driver.
+// GL thread only. Code that changes any of it with direct GL calls has to invalidate() afterwards.
+class GlState {
+public:
+    static const GLuint TEXTURE_UNITS = 16;
+
+    struct FrameStats {
+        size_t calls = 0;      // Issued to the driver.
+        size_t redundant = 0;  // Dropped, the state already matched.
+    };
+
+    static GlState& shared();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertex_array);
+    // Same as the GL calls: bindTexture binds on the active unit.
+    void activeTexture(GLenum unit);
+    void bindTexture(GLenum target, GLuint texture);
+    // Binds `texture` on `unit` (0-based), selecting the unit only when the binding changes. Units beyond
+    // TEXTURE_UNITS and targets other than 2D and cube maps are passed through untracked.
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+    // Issues only the calls for what differs from the current state.
+    void apply(const PipelineState& state);
+
+    // GL unbinds deleted objects by itself, and a new object may get the name again, so it must not be taken
+    // for still bound. GlHandle calls these.
+    void forgetProgram(GLuint program);
+    void forgetVertexArray(GLuint vertex_array);
+    void forgetTexture(GLuint texture);
+    // Forgets everything, the next call of each kind goes to the driver.
+    void invalidate();
+
+    // Render loop, once per frame. Keeps this frame's counters as lastFrame() and starts counting the next.
+    void endFrame();
+    const FrameStats& lastFrame() const { return last_frame_; }
+    const FrameStats& currentFrame() const { return frame_; }
+
+private:
+    // Tracked targets, each with its own binding per unit: GL_TEXTURE_2D and GL_TEXTURE_CUBE_MAP.
+    static const int TEXTURE_TARGETS = 2;
+    static const GLuint UNKNOWN = ~0u;
+
+    GlState();
+    // Counts a call and whether it went out, returns `changed`.
+    bool track(bool changed);
+    void applyDepth(const DepthState& depth);
+    void applyStencil(const StencilState& stencil);
+    void applyBlend(const BlendState& blend);
+    void applyCull(const CullState& cull);
+    void setCapability(GLenum capability, bool enabled, bool& current);
+
+    GLuint program_;
+    GLuint vertex_array_;
+    GLuint active_unit_;
+    GLuint textures_[TEXTURE_TARGETS][TEXTURE_UNITS];
+    // Pipeline state as last applied, meaningless while !pipeline_known_.
+    PipelineState::Desc pipeline_;
+    bool pipeline_known_ = false;
+    FrameStats frame_;
+    FrameStats last_frame_;
+};
+
+#endif
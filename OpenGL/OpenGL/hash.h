@@ -0,0 +1,31 @@
+#pragma once
+#ifndef HASH_H
+#define HASH_H
+
+#include <cstddef>
+#include <cstdint>
+
+// 64-bit FNV-1a, used for cache keys.
+const uint64_t FNV_OFFSET_BASIS = 0xcbf29ce484222325ull;
+
+inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Same hash over a zero-terminated string, usable in constant expressions to hash names at compile time.
+constexpr uint64_t fnv1aString(const char* text, uint64_t hash = FNV_OFFSET_BASIS)
+{
+    for (; *text != '\0'; ++text) {
+        hash ^= static_cast<unsigned char>(*text);
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+#endif
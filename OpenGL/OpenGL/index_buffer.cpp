@@ -0,0 +1,111 @@
+#include "index_buffer.h"
+
+#include "mesh.h"
+
+namespace IndexBuffer {
+    void split(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+               std::vector<uint16_t>& indices16, std::vector<Chunk>& chunks)
+    {
+        indices16.clear();
+        chunks.clear();
+        indices16.reserve(indices.size());
+
+        if (vertices.size() <= MAX_CHUNK_VERTICES) {
+            indices16.assign(indices.begin(), indices.end());
+            Chunk chunk;
+            chunk.index_count = static_cast<uint32_t>(indices.size());
+            chunks.push_back(chunk);
+            return;
+        }
+
+        // Local slot of each source vertex in the current chunk, valid while its stamp is the chunk's.
+        std::vector<uint32_t> local(vertices.size(), 0);
+        std::vector<uint32_t> stamp(vertices.size(), ~0u);
+        std::vector<Vertex> output;
+        output.reserve(vertices.size());
+
+        Chunk chunk;
+        uint32_t chunk_id = 0;
+        for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+            unsigned int new_vertices = 0;
+            for (int k = 0; k < 3; ++k) {
+                new_vertices += stamp[indices[t + k]] != chunk_id ? 1 : 0;
+            }
+            if (output.size() - chunk.base_vertex + new_vertices > MAX_CHUNK_VERTICES) {
+                chunks.push_back(chunk);
+                chunk.first_index = static_cast<uint32_t>(indices16.size());
+                chunk.index_count = 0;
+                chunk.base_vertex = static_cast<uint32_t>(output.size());
+                ++chunk_id;
+            }
+            for (int k = 0; k < 3; ++k) {
+                unsigned int index = indices[t + k];
+                if (stamp[index] != chunk_id) {
+                    stamp[index] = chunk_id;
+                    local[index] = static_cast<uint32_t>(output.size()) - chunk.base_vertex;
+                    output.push_back(vertices[index]);
+                }
+                indices16.push_back(static_cast<uint16_t>(local[index]));
+            }
+            chunk.index_count += 3;
+        }
+        chunks.push_back(chunk);
+        vertices.swap(output);
+    }
+
+    void appendLod(const std::vector<unsigned int>& indices, float error, std::vector<uint16_t>& indices16,
+                   std::vector<Chunk>& chunks, std::vector<Lod>& lods)
+    {
+        Chunk chunk;
+        chunk.first_index = static_cast<uint32_t>(indices16.size());
+        chunk.index_count = static_cast<uint32_t>(indices.size());
+        indices16.insert(indices16.end(), indices.begin(), indices.end());
+
+        Lod lod;
+        lod.first_chunk = static_cast<uint32_t>(chunks.size());
+        lod.chunk_count = 1;
+        lod.error = error;
+        chunks.push_back(chunk);
+        lods.push_back(lod);
+    }
+
+    void encode(const uint16_t* indices, size_t count, std::vector<unsigned char>& encoded)
+    {
+        encoded.clear();
+        encoded.reserve(count);
+        int32_t previous = 0;
+        for (size_t i = 0; i < count; ++i) {
+            int32_t delta = int32_t(indices[i]) - previous;
+            previous = indices[i];
+            uint32_t zigzag = (uint32_t(delta) << 1) ^ uint32_t(delta >> 31);
+            while (zigzag >= 0x80) {
+                encoded.push_back(static_cast<unsigned char>(zigzag | 0x80));
+                zigzag >>= 7;
+            }
+            encoded.push_back(static_cast<unsigned char>(zigzag));
+        }
+    }
+
+    bool decode(const unsigned char* encoded, size_t size, uint16_t* indices, size_t count)
+    {
+        const unsigned char* end = encoded + size;
+        int32_t previous = 0;
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t zigzag = 0;
+            // A 17-bit delta needs at most three bytes.
+            for (int shift = 0;; shift += 7) {
+                if (encoded == end || shift > 14) {
+                    return false;
+                }
+                unsigned char byte = *encoded++;
+                zigzag |= uint32_t(byte & 0x7f) << shift;
+                if ((byte & 0x80) == 0) {
+                    break;
+                }
+            }
+            previous += int32_t(zigzag >> 1) ^ -int32_t(zigzag & 1);
+            indices[i] = static_cast<uint16_t>(previous);
+        }
+        return encoded == end;
+    }
+}  // namespace IndexBuffer
@@ -0,0 +1,49 @@
+#pragma once
+#ifndef INDEX_BUFFER_H
+#define INDEX_BUFFER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct Vertex;
+
+// 16-bit index buffers and their on-disk encoding.
+namespace IndexBuffer {
+    const size_t MAX_CHUNK_VERTICES = 65536;
+
+    // A draw range whose indices address at most MAX_CHUNK_VERTICES vertices from base_vertex on. Offsets are
+    // relative to the mesh's own index and vertex ranges.
+    struct Chunk {
+        uint32_t first_index = 0;
+        uint32_t index_count = 0;
+        uint32_t base_vertex = 0;
+    };
+
+    // A level of detail: a run of a mesh's chunks, all drawing from the same vertices. `error` is how far (model
+    // units) the simplified surface may be from the full one, 0 for the full mesh itself.
+    struct Lod {
+        uint32_t first_chunk = 0;
+        uint32_t chunk_count = 0;
+        float error = 0.0f;
+    };
+
+    // Converts a triangle list to 16-bit indices. Meshes with up to MAX_CHUNK_VERTICES vertices become one chunk
+    // as they are. Larger ones are cut, in triangle order, into chunks with their own copy of the vertices they
+    // use, so `vertices` grows by the vertices shared across chunk borders.
+    void split(std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+               std::vector<uint16_t>& indices16, std::vector<Chunk>& chunks);
+
+    // Appends a simplified level as one more chunk after the ones already in `indices16`. Only valid for meshes
+    // that `split` kept in a single chunk, the level then reuses its vertices as they are.
+    void appendLod(const std::vector<unsigned int>& indices, float error, std::vector<uint16_t>& indices16,
+                   std::vector<Chunk>& chunks, std::vector<Lod>& lods);
+
+    // Zigzag-encoded difference to the previous index as a LEB128 varint. Indices of a fetch-ordered mesh stay
+    // close to each other, so most take a single byte.
+    void encode(const uint16_t* indices, size_t count, std::vector<unsigned char>& encoded);
+    // Returns false if `encoded` doesn't hold exactly `count` indices.
+    bool decode(const unsigned char* encoded, size_t size, uint16_t* indices, size_t count);
+}  // namespace IndexBuffer
+
+#endif
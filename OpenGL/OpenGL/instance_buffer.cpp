@@ -0,0 +1,52 @@
+#include "instance_buffer.h"
+
+#include <algorithm>
+
+#include "gl_state.h"
+
+void InstanceBuffer::update(const glm::mat4* transforms, size_t count)
+{
+    if (!buffer_) {
+        buffer_ = GlBuffer::create();
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_.get());
+    // Doubling keeps a growing scene from reallocating every frame.
+    if (count > capacity_) {
+        capacity_ = std::max(count, capacity_ * 2);
+    }
+    glBufferData(GL_ARRAY_BUFFER, capacity_ * sizeof(glm::mat4), nullptr, GL_STREAM_DRAW);
+    if (count > 0) {
+        glBufferSubData(GL_ARRAY_BUFFER, 0, count * sizeof(glm::mat4), transforms);
+    }
+    size_ = count;
+}
+
+void InstanceBuffer::attach() const
+{
+    glBindBuffer(GL_ARRAY_BUFFER, buffer_.get());
+    // A mat4 attribute takes one location per column.
+    for (GLuint column = 0; column < 4; ++column) {
+        GLuint location = FIRST_LOCATION + column;
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4),
+                              (void*)(column * sizeof(glm::vec4)));
+        glVertexAttribDivisor(location, 1);
+    }
+}
+
+void InstanceBuffer::detach()
+{
+    for (GLuint column = 0; column < 4; ++column) {
+        glDisableVertexAttribArray(FIRST_LOCATION + column);
+    }
+}
+
+void InstanceBuffer::draw(GLuint vertex_array, GLsizei vertex_count) const
+{
+    if (size_ == 0) {
+        return;
+    }
+    GlState::shared().bindVertexArray(vertex_array);
+    attach();
+    glDrawArraysInstanced(GL_TRIANGLES, 0, vertex_count, static_cast<GLsizei>(size_));
+}
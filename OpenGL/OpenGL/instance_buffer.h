@@ -0,0 +1,41 @@
+#pragma once
+#ifndef INSTANCE_BUFFER_H
+#define INSTANCE_BUFFER_H
+
+#include <cstddef>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include "gl_handle.h"
+
+// Per-instance model matrices in a vertex buffer, read by the INSTANCED permutation of the shaders (see
+// common/instancing.glsl) as a mat4 attribute at locations FIRST_LOCATION to FIRST_LOCATION + 3, advancing once per
+// instance. Every update orphans the storage, so rewriting it each frame doesn't wait for the previous frame's draws.
+// Must only be used on the GL thread.
+class InstanceBuffer {
+public:
+    // After position, normal and texture coordinates, see vertex_format.h.
+    static const GLuint FIRST_LOCATION = 4;
+
+    void update(const glm::mat4* transforms, size_t count);
+    void update(const std::vector<glm::mat4>& transforms) { update(transforms.data(), transforms.size()); }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Points the instance attributes of the bound vertex array at this buffer.
+    void attach() const;
+    // Disables the instance attributes of the bound vertex array again, for vertex arrays shared with draws that
+    // aren't instanced.
+    static void detach();
+    // Draws `vertex_count` vertices of `vertex_array` once per instance.
+    void draw(GLuint vertex_array, GLsizei vertex_count) const;
+
+private:
+    GlBuffer buffer_;
+    size_t size_ = 0;
+    size_t capacity_ = 0;  // In matrices.
+};
+
+#endif
@@ -7,15 +7,15 @@ out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "../common/frame_data.glsl"
+#include "../common/instancing.glsl"
 
 void main()
 {
-	FragPos = vec3(model * vec4(iPos, 1.0));
+	mat4 transform = modelMatrix();
+	FragPos = vec3(transform * vec4(iPos, 1.0));
 	// ȱŶԷӰ
-	Normal = mat3(transpose(inverse(model))) * iNormal;
+	Normal = mat3(transpose(inverse(transform))) * iNormal;
 	TexCoords = iTexCoords;
 	gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
@@ -1,11 +1,10 @@
 #version 330 core
 layout (location = 0) in vec3 iPosition;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "../common/frame_data.glsl"
+#include "../common/instancing.glsl"
 
 void main()
 {
-	gl_Position = projection * view * model * vec4(iPosition, 1.0);
+	gl_Position = projection * view * modelMatrix() * vec4(iPosition, 1.0);
 }
\ No newline at end of file
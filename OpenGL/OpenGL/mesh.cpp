@@ -1,79 +1,275 @@
 #include "mesh.h"
 #include <glad/glad.h>
 
-static unsigned int bindVertexArrayObject()
+#include <algorithm>
+#include <utility>
+
+#include "gl_state.h"
+#include "hash.h"
+
+const char* textureRoleName(TextureRole role)
 {
-    // Vertex array object.
-    unsigned int vertex_array_object;
-    glGenVertexArrays(1, &vertex_array_object);
-    glBindVertexArray(vertex_array_object);
-    return vertex_array_object;
+    switch (role) {
+    case TextureRole::SPECULAR:
+        return "texture_specular";
+    case TextureRole::NORMAL:
+        return "texture_normal";
+    default:
+        return "texture_diffuse";
+    }
 }
 
-static unsigned int bindVertexBufferObject(vector<Vertex> vertices)
+Mesh::Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, bool keep_cpu_geometry)
+    : textures(std::move(textures))
 {
-    // Vertex buffer object.
-    unsigned int vertex_buffer_object;
-    glGenBuffers(1, &vertex_buffer_object);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer_object);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), vertices.data(), GL_STATIC_DRAW);
-    return vertex_buffer_object;
+    vector<uint16_t> indices16;
+    if (vertices.size() <= IndexBuffer::MAX_CHUNK_VERTICES) {
+        // A single chunk leaves the vertices as they are, no copy needed.
+        IndexBuffer::split(vertices, indices, indices16, chunks_);
+        setupMesh(vertices.data(), vertices.size(), indices16.data(), indices16.size());
+    } else if (keep_cpu_geometry) {
+        vector<Vertex> split_vertices = vertices;
+        IndexBuffer::split(split_vertices, indices, indices16, chunks_);
+        setupMesh(split_vertices.data(), split_vertices.size(), indices16.data(), indices16.size());
+    } else {
+        IndexBuffer::split(vertices, indices, indices16, chunks_);
+        setupMesh(vertices.data(), vertices.size(), indices16.data(), indices16.size());
+    }
+
+    if (keep_cpu_geometry) {
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+    }
 }
 
-static unsigned int bindElementBufferObject(vector<unsigned int> indices)
+Mesh::Mesh(const Vertex* vertices, size_t vertex_count, const uint16_t* indices, size_t index_count,
+           const vector<IndexBuffer::Chunk>& chunks, const vector<IndexBuffer::Lod>& lods,
+           const vector<Texture>& textures)
 {
-    // Element Buffer object.
-    unsigned int element_buffer_object;
-    glGenBuffers(1, &element_buffer_object);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, element_buffer_object);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
-    return element_buffer_object;
+    this->textures = textures;
+    this->chunks_ = chunks;
+    this->lods_ = lods;
+
+    setupMesh(vertices, vertex_count, indices, index_count);
 }
 
-Mesh::Mesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices, const vector<Texture>& textures)
+Mesh::Mesh(const QuantizedVertices& vertices, VertexFormat format, const uint16_t* indices, size_t index_count,
+           const vector<IndexBuffer::Chunk>& chunks, const vector<IndexBuffer::Lod>& lods,
+           const vector<Texture>& textures)
 {
-    this->vertices = vertices;
-    this->indices = indices;
     this->textures = textures;
+    this->chunks_ = chunks;
+    this->lods_ = lods;
+    this->format_ = format;
+    this->position_offset_ = vertices.position_offset;
+    this->position_scale_ = vertices.position_scale;
 
-    setupMesh();
+    setupMesh(vertices.vertices.data(), vertices.vertices.size(), indices, index_count);
 }
 
-void Mesh::draw(Shader shader) {
-    unsigned int diffuseIdx = 0;
-    unsigned int specularIdx = 0;
-    for (unsigned int i = 0; i < textures.size(); i++) {
-        glActiveTexture(GL_TEXTURE0 + i);
-        if (textures[i].type == "texture_diffuse") {
-            diffuseIdx++;
-        } else if (textures[i].type == "texture_specular") {
-            specularIdx++;
+bool Mesh::hasTexture(TextureRole role) const
+{
+    for (const Texture& texture : textures) {
+        if (texture.role == role) {
+            return true;
         }
-        shader.setInt((textures[i].type + std::to_string(diffuseIdx)), i);
-        glBindTexture(GL_TEXTURE_2D, textures[i].id);
     }
+    return false;
+}
+
+void Mesh::draw(Shader& shader)
+{
+    draw(shader, 0);
+}
+
+size_t Mesh::draw(Shader& shader, size_t lod)
+{
+    bindMaterial(shader);
+    GeometryArena& arena = GeometryArena::shared(format_);
+    const IndexBuffer::Lod& level = lods_[std::min(lod, lods_.size() - 1)];
+    size_t triangles = 0;
+    for (uint32_t i = level.first_chunk; i < level.first_chunk + level.chunk_count; ++i) {
+        arena.draw(geometry_.handle(), chunks_[i]);
+        triangles += chunks_[i].index_count / 3;
+    }
+    return triangles;
+}
 
-    glBindVertexArray(vao);     // Bind VAO.
-    glDrawElements(GL_TRIANGLES, indices.size(), GL_UNSIGNED_INT, 0);
-    glBindVertexArray(0);       // Remove VAO.
+size_t Mesh::drawInstanced(Shader& shader, const InstanceBuffer& instances, size_t lod)
+{
+    if (instances.empty()) {
+        return 0;
+    }
+    bindMaterial(shader);
+    instances.attach();
+    GeometryArena& arena = GeometryArena::shared(format_);
+    const IndexBuffer::Lod& level = lods_[std::min(lod, lods_.size() - 1)];
+    GLsizei instance_count = static_cast<GLsizei>(instances.size());
+    size_t triangles = 0;
+    for (uint32_t i = level.first_chunk; i < level.first_chunk + level.chunk_count; ++i) {
+        arena.drawInstanced(geometry_.handle(), chunks_[i], instance_count);
+        triangles += chunks_[i].index_count / 3 * instances.size();
+    }
+    // The arena's vertex array is shared with the draws that aren't instanced.
+    InstanceBuffer::detach();
+    return triangles;
 }
 
-void Mesh::setupMesh()
+void Mesh::draw(Shader& shader, size_t lod, const Culling::View& view, Culling::Stats& stats)
 {
-    // Initialize objects.
-    this->vao = bindVertexArrayObject();
-    this->vbo = bindVertexBufferObject(this->vertices);
-    this->ebo = bindElementBufferObject(this->indices);
+    const IndexBuffer::Lod& level = lods_[std::min(lod, lods_.size() - 1)];
+    uint32_t first_chunk = level.first_chunk;
+    uint32_t last_chunk = level.first_chunk + level.chunk_count;
+    bool has_meshlets = !meshlets_.empty();
+    size_t meshlet_count = has_meshlets ? chunk_meshlets_[last_chunk] - chunk_meshlets_[first_chunk] : 0;
+    for (uint32_t i = first_chunk; i < last_chunk; ++i) {
+        stats.triangles += chunks_[i].index_count / 3;
+    }
+    stats.clusters += meshlet_count;
 
-    // Set vertex positions.
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
-    // Set vertex normals.
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, normal));
-    // Set vertex normals.
-    glEnableVertexAttribArray(2);
-    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, tex_coords));
+    if (!Culling::boxVisible(view.frustum, bounding_box_)) {
+        stats.frustum_culled += meshlet_count;
+        return;
+    }
+    bool bound = false;
+    GeometryArena& arena = GeometryArena::shared(format_);
+    auto submit = [&](const IndexBuffer::Chunk& range) {
+        if (!bound) {
+            bindMaterial(shader);
+            bound = true;
+        }
+        arena.draw(geometry_.handle(), range);
+        stats.triangles_drawn += range.index_count / 3;
+        ++stats.draw_calls;
+    };
+
+    for (uint32_t c = first_chunk; c < last_chunk; ++c) {
+        if (!has_meshlets) {
+            submit(chunks_[c]);
+            continue;
+        }
+        // Runs of visible meshlets are contiguous in the index buffer and go out as one draw.
+        IndexBuffer::Chunk run;
+        run.base_vertex = chunks_[c].base_vertex;
+        for (uint32_t m = chunk_meshlets_[c]; m < chunk_meshlets_[c + 1]; ++m) {
+            const Meshlets::Meshlet& meshlet = meshlets_[m];
+            bool visible = false;
+            if (!Culling::sphereVisible(view.frustum, meshlet.center, meshlet.radius)) {
+                ++stats.frustum_culled;
+            } else if (Culling::coneBackfacing(meshlet.cone_apex, meshlet.cone_axis, meshlet.cone_cutoff, view.eye)) {
+                ++stats.backface_culled;
+            } else {
+                visible = true;
+            }
 
-    glBindVertexArray(0);
-}
\ No newline at end of file
+            if (visible && run.index_count > 0 && run.first_index + run.index_count == meshlet.first_index) {
+                run.index_count += meshlet.index_count;
+            } else if (visible) {
+                if (run.index_count > 0) {
+                    submit(run);
+                }
+                run.first_index = meshlet.first_index;
+                run.index_count = meshlet.index_count;
+            }
+        }
+        if (run.index_count > 0) {
+            submit(run);
+        }
+    }
+}
+
+size_t Mesh::selectLod(const glm::vec3& eye, float pixels_per_unit, float max_pixel_error) const
+{
+    // Distance to the closest point of the bounds, inside them nothing but the full mesh is safe.
+    float distance = glm::length(eye - bounds_center_) - bounds_radius_;
+    if (distance <= 0.0f) {
+        return 0;
+    }
+    // Errors grow along the chain, so the first level from the coarse end that fits is the coarsest one.
+    for (size_t lod = lods_.size() - 1; lod > 0; --lod) {
+        if (lods_[lod].error * pixels_per_unit / distance <= max_pixel_error) {
+            return lod;
+        }
+    }
+    return 0;
+}
+
+void Mesh::setBoundingSphere(const glm::vec3& center, float radius)
+{
+    bounds_center_ = center;
+    bounds_radius_ = radius;
+}
+
+void Mesh::setMeshlets(const vector<Meshlets::Meshlet>& meshlets)
+{
+    meshlets_ = meshlets;
+    chunk_meshlets_.assign(chunks_.size() + 1, 0);
+    for (const Meshlets::Meshlet& meshlet : meshlets_) {
+        ++chunk_meshlets_[meshlet.chunk + 1];
+    }
+    for (size_t i = 0; i < chunks_.size(); ++i) {
+        chunk_meshlets_[i + 1] += chunk_meshlets_[i];
+    }
+}
+
+void Mesh::releaseGeometry()
+{
+    geometry_.reset();
+}
+
+void Mesh::releaseCpuGeometry()
+{
+    vector<Vertex>().swap(vertices);
+    vector<unsigned int>().swap(indices);
+}
+
+void Mesh::setupMaterial()
+{
+    // Numbered per role: texture_diffuse1, texture_diffuse2, texture_specular1, ...
+    unsigned int numbers[TEXTURE_ROLE_COUNT] = {};
+    sampler_names_.clear();
+    sampler_names_.reserve(textures.size());
+    for (const Texture& texture : textures) {
+        unsigned int number = ++numbers[static_cast<size_t>(texture.role)];
+        sampler_names_.push_back(UniformName(textureRoleName(texture.role) + std::to_string(number)));
+    }
+
+    // Equal texture lists give equal keys, so the RenderQueue draws meshes sharing a material back to back.
+    uint64_t hash = FNV_OFFSET_BASIS;
+    for (const Texture& texture : textures) {
+        hash = fnv1a(&texture.id, sizeof(texture.id), hash);
+    }
+    material_key_ = static_cast<uint16_t>(hash ^ hash >> 16 ^ hash >> 32 ^ hash >> 48);
+}
+
+void Mesh::bindMaterial(Shader& shader)
+{
+    for (unsigned int i = 0; i < textures.size(); i++) {
+        shader.setInt(shader.uniform(sampler_names_[i]), i);
+        // Meshes sharing a material leave the units as they are.
+        GlState::shared().bindTexture(i, GL_TEXTURE_2D, textures[i].id);
+    }
+
+    // How to decode the vertex format, identity for full floats.
+    constexpr UniformName POSITION_OFFSET("positionOffset");
+    constexpr UniformName POSITION_SCALE("positionScale");
+    constexpr UniformName OCTAHEDRAL_NORMALS("octahedralNormals");
+    shader.setVec3(shader.uniform(POSITION_OFFSET), position_offset_);
+    shader.setVec3(shader.uniform(POSITION_SCALE), position_scale_);
+    shader.setBool(shader.uniform(OCTAHEDRAL_NORMALS), format_ != VertexFormat::FLOAT);
+
+    // Every mesh of a format lives in the same VAO, so consecutive draws don't switch vertex state.
+    GeometryArena::shared(format_).bind();
+}
+
+void Mesh::setupMesh(const void* vertices, size_t vertex_count, const uint16_t* indices, size_t index_count)
+{
+    setupMaterial();
+    if (lods_.empty()) {
+        IndexBuffer::Lod lod;
+        lod.chunk_count = static_cast<uint32_t>(chunks_.size());
+        lods_.push_back(lod);
+    }
+    GeometryArena& arena = GeometryArena::shared(format_);
+    geometry_ = GeometryAllocation(arena, arena.allocate(vertices, vertex_count, indices, index_count));
+}
@@ -2,11 +2,18 @@
 #ifndef MESH_H
 #define MESH_H
 #include <glm.hpp>
+#include <cstddef>
+#include <cstdint>
 #include <string>
 #include <vector>
 
 #include "shader.h"
-#include "assimp/types.h"
+#include "culling.h"
+#include "geometry_arena.h"
+#include "index_buffer.h"
+#include "instance_buffer.h"
+#include "meshlet.h"
+#include "vertex_format.h"
 
 using std::string;
 using std::vector;
@@ -17,27 +24,104 @@ struct Vertex {
     glm::vec2 tex_coords;
 };
 
+enum class TextureRole : uint8_t {
+    DIFFUSE,
+    SPECULAR,
+    NORMAL,
+};
+const size_t TEXTURE_ROLE_COUNT = 3;
+
+// Sampler uniform prefix of a role, "texture_diffuse" etc. The shaders number them from 1.
+const char* textureRoleName(TextureRole role);
+
+// Reference to a texture of the TextureCache, small enough to copy freely.
 struct Texture {
-    unsigned int id;
-    string type;
-    aiString path;
+    unsigned int id = 0;    // GL texture.
+    uint32_t path = 0;      // StringTable::shared() id of the path, relative to the model.
+    TextureRole role = TextureRole::DIFFUSE;
 };
 
+// Owns its range in the GeometryArena, so it can be moved but not copied.
 class Mesh {
 public:
+    // CPU copies of the geometry, only kept by the first constructor when asked to.
     vector<Vertex> vertices;
     vector<unsigned int> indices;
     vector<Texture> textures;
 
-    Mesh(const vector<Vertex>& vertices, const vector<unsigned int>& indices, const vector<Texture>& textures);
-    void draw(Shader shader);
+    // Splits the indices into 16-bit chunks on the way, see IndexBuffer::split. Without `keep_cpu_geometry` the
+    // vertices and indices are dropped once uploaded.
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures,
+         bool keep_cpu_geometry = true);
+    // Uploads straight from caller-owned memory (e.g. a mapped mesh cache) and keeps no CPU copy of the geometry.
+    // `lods` picks the chunks of each level of detail, empty means a single level drawing every chunk.
+    Mesh(const Vertex* vertices, size_t vertex_count, const uint16_t* indices, size_t index_count,
+         const vector<IndexBuffer::Chunk>& chunks, const vector<IndexBuffer::Lod>& lods,
+         const vector<Texture>& textures);
+    // Uploads vertices already converted to one of the compact formats.
+    Mesh(const QuantizedVertices& vertices, VertexFormat format, const uint16_t* indices, size_t index_count,
+         const vector<IndexBuffer::Chunk>& chunks, const vector<IndexBuffer::Lod>& lods,
+         const vector<Texture>& textures);
+    Mesh(Mesh&&) noexcept = default;
+    Mesh& operator=(Mesh&&) noexcept = default;
+    Mesh(const Mesh&) = delete;
+    Mesh& operator=(const Mesh&) = delete;
+
+    // Draws the full detail level. Every draw leaves the arena's VAO bound, see GeometryArena::bind.
+    void draw(Shader& shader);
+    // Draws one level of detail, returns the number of triangles submitted.
+    size_t draw(Shader& shader, size_t lod);
+    // Draws the meshlets of one level that are inside `view`'s frustum and not facing away from its eye, merging
+    // neighbouring visible meshlets into one range. Levels without meshlets are culled as a whole.
+    void draw(Shader& shader, size_t lod, const Culling::View& view, Culling::Stats& stats);
+    // Draws one level of detail once per transform in `instances`, with one draw call per chunk. Needs the
+    // INSTANCED permutation of the shader. Returns the number of triangles submitted.
+    size_t drawInstanced(Shader& shader, const InstanceBuffer& instances, size_t lod = 0);
+
+    // Coarsest level whose error, projected from `eye` (model space), stays within `max_pixel_error` pixels.
+    // `pixels_per_unit` is the size in pixels of one model unit at distance 1.
+    size_t selectLod(const glm::vec3& eye, float pixels_per_unit, float max_pixel_error) const;
+    // Whether the material has a texture for `role`, to pick the shader variant that samples it.
+    bool hasTexture(TextureRole role) const;
+    // 16-bit hash of the textures, for RenderQueue::Item::material.
+    uint16_t materialKey() const { return material_key_; }
+    const glm::vec3& boundsCenter() const { return bounds_center_; }
+    // Model space box around the vertices, what the frustum culling of whole meshes tests.
+    const Culling::Box& boundingBox() const { return bounding_box_; }
+    void setBoundingBox(const Culling::Box& box) { bounding_box_ = box; }
+    size_t lodCount() const { return lods_.size(); }
+    const vector<IndexBuffer::Lod>& lods() const { return lods_; }
+    // Model space sphere enclosing the vertices, used as the distance reference for LOD selection.
+    void setBoundingSphere(const glm::vec3& center, float radius);
+    // Meshlets of all chunks, in chunk order, see Meshlets::build.
+    void setMeshlets(const vector<Meshlets::Meshlet>& meshlets);
+
+    // Returns the geometry to the arena before the mesh dies.
+    void releaseGeometry();
+    // Drops the CPU copies of vertices and indices, the GPU copy is all drawing needs.
+    void releaseCpuGeometry();
+    GeometryArena::Handle geometry() const { return geometry_.handle(); }
 
 private:
-    void setupMesh();
+    void setupMesh(const void* vertices, size_t vertex_count, const uint16_t* indices, size_t index_count);
+    // Names the sampler uniform of every texture once, so binding the material doesn't build or hash strings.
+    void setupMaterial();
+    void bindMaterial(Shader& shader);
 
-    unsigned int vao;
-    unsigned int vbo;
-    unsigned int ebo;
+    // Sub-allocation in the GeometryArena of format_.
+    GeometryAllocation geometry_;
+    vector<UniformName> sampler_names_;  // "texture_diffuse1", ... by texture.
+    uint16_t material_key_ = 0;
+    vector<IndexBuffer::Chunk> chunks_;
+    vector<IndexBuffer::Lod> lods_;
+    glm::vec3 bounds_center_ = glm::vec3(0.0f);
+    float bounds_radius_ = 0.0f;
+    Culling::Box bounding_box_;
+    vector<Meshlets::Meshlet> meshlets_;
+    vector<uint32_t> chunk_meshlets_;  // Meshlets of chunk i: [chunk_meshlets_[i], chunk_meshlets_[i + 1]).
+    VertexFormat format_ = VertexFormat::FLOAT;
+    glm::vec3 position_offset_ = glm::vec3(0.0f);
+    glm::vec3 position_scale_ = glm::vec3(1.0f);
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include "mesh_cache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+
+#include "hash.h"
+
+namespace MeshCache {
+    namespace {
+        const uint32_t MAGIC = 0x4853454d;  // "MESH"
+
+        struct FileHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t source_hash;
+            uint32_t import_flags;
+            uint32_t vertex_size;
+            uint32_t mesh_count;
+            uint32_t reserved;
+        };
+
+        struct MeshHeader {
+            uint32_t vertex_count;
+            uint32_t index_count;
+            uint32_t chunk_count;
+            uint32_t encoded_index_size;
+            uint32_t texture_count;
+            uint32_t lod_count;
+            uint32_t meshlet_count;
+            uint32_t reserved;
+        };
+
+        struct SceneHeader {
+            uint32_t node_count;
+            uint32_t instance_count;
+        };
+
+        size_t align4(size_t offset)
+        {
+            return (offset + 3) & ~size_t(3);
+        }
+
+        // Bounds-checked cursor over the mapped file.
+        class Cursor {
+        public:
+            Cursor(const unsigned char* data, size_t size) : data_(data), size_(size) {}
+
+            const unsigned char* take(size_t bytes)
+            {
+                if (bytes > size_ - offset_) {
+                    return nullptr;
+                }
+                const unsigned char* p = data_ + offset_;
+                offset_ += bytes;
+                return p;
+            }
+            template <typename T>
+            bool read(T& value)
+            {
+                const unsigned char* p = take(sizeof(T));
+                if (p != nullptr) {
+                    std::memcpy(&value, p, sizeof(T));
+                }
+                return p != nullptr;
+            }
+            void align() { offset_ = align4(offset_) < size_ ? align4(offset_) : size_; }
+
+        private:
+            const unsigned char* data_;
+            size_t size_;
+            size_t offset_ = 0;
+        };
+
+        bool readMesh(Cursor& cursor, CookedMesh& mesh, vector<uint16_t>& indices)
+        {
+            MeshHeader header;
+            if (!cursor.read(header) || !cursor.read(mesh.optimization)) {
+                return false;
+            }
+            mesh.vertex_count = header.vertex_count;
+            mesh.vertices = reinterpret_cast<const Vertex*>(cursor.take(size_t(header.vertex_count) * sizeof(Vertex)));
+            if (mesh.vertices == nullptr) {
+                return false;
+            }
+            mesh.chunks.resize(header.chunk_count);
+            for (IndexBuffer::Chunk& chunk : mesh.chunks) {
+                // Draws use the chunks as they are, so they must stay inside the mesh's own ranges.
+                if (!cursor.read(chunk) || uint64_t(chunk.first_index) + chunk.index_count > header.index_count ||
+                    chunk.base_vertex >= header.vertex_count) {
+                    return false;
+                }
+            }
+            mesh.lods.resize(header.lod_count);
+            for (IndexBuffer::Lod& lod : mesh.lods) {
+                if (!cursor.read(lod) || lod.first_chunk + lod.chunk_count > header.chunk_count) {
+                    return false;
+                }
+            }
+            mesh.meshlets.resize(header.meshlet_count);
+            for (Meshlets::Meshlet& meshlet : mesh.meshlets) {
+                if (!cursor.read(meshlet) || meshlet.chunk >= header.chunk_count) {
+                    return false;
+                }
+            }
+
+            const unsigned char* encoded = cursor.take(header.encoded_index_size);
+            indices.resize(header.index_count);
+            if (encoded == nullptr ||
+                !IndexBuffer::decode(encoded, header.encoded_index_size, indices.data(), indices.size())) {
+                return false;
+            }
+            for (const IndexBuffer::Chunk& chunk : mesh.chunks) {
+                for (uint32_t i = chunk.first_index; i < chunk.first_index + chunk.index_count; ++i) {
+                    if (uint64_t(indices[i]) + chunk.base_vertex >= header.vertex_count) {
+                        return false;
+                    }
+                }
+            }
+            mesh.index_count = header.index_count;
+            mesh.indices = indices.data();
+
+            for (uint32_t i = 0; i < header.texture_count; ++i) {
+                // Role and path length.
+                uint32_t fields[2];
+                if (!cursor.read(fields) || fields[0] >= TEXTURE_ROLE_COUNT) {
+                    return false;
+                }
+                const char* path = reinterpret_cast<const char*>(cursor.take(fields[1]));
+                if (path == nullptr) {
+                    return false;
+                }
+                mesh.textures.push_back({static_cast<TextureRole>(fields[0]), string(path, fields[1])});
+            }
+            cursor.align();
+            return true;
+        }
+
+        bool readScene(Cursor& cursor, size_t mesh_count, SceneGraph& scene, vector<MeshInstance>& instances)
+        {
+            SceneHeader header;
+            if (!cursor.read(header)) {
+                return false;
+            }
+            vector<int32_t> parents(header.node_count);
+            for (uint32_t i = 0; i < header.node_count; ++i) {
+                // Depth-first order: parents come first.
+                if (!cursor.read(parents[i]) || parents[i] < SceneGraph::NO_PARENT || parents[i] >= int32_t(i)) {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < header.node_count; ++i) {
+                glm::mat4 local;
+                if (!cursor.read(local)) {
+                    return false;
+                }
+                scene.addNode(parents[i], local);
+            }
+            instances.resize(header.instance_count);
+            for (MeshInstance& instance : instances) {
+                if (!cursor.read(instance) || instance.node >= header.node_count || instance.mesh >= mesh_count) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        void writePadding(std::ofstream& out)
+        {
+            static const char zeros[4] = {0, 0, 0, 0};
+            size_t offset = static_cast<size_t>(out.tellp());
+            out.write(zeros, align4(offset) - offset);
+        }
+
+        // Files named by the "mtllib" lines of an .obj, relative to it. Assimp reads the materials, and with them the
+        // texture paths stored in the cache, from these.
+        vector<string> materialLibraries(const string& model_path, const unsigned char* data, size_t size)
+        {
+            vector<string> libraries;
+            std::filesystem::path directory = std::filesystem::path(model_path).parent_path();
+            const char* text = reinterpret_cast<const char*>(data);
+            size_t line = 0;
+            while (line < size) {
+                size_t end = line;
+                while (end < size && text[end] != '\n') {
+                    ++end;
+                }
+                if (end - line > 7 && std::strncmp(text + line, "mtllib", 6) == 0 &&
+                    (text[line + 6] == ' ' || text[line + 6] == '\t')) {
+                    // Whitespace separated names.
+                    size_t i = line + 7;
+                    while (i < end) {
+                        while (i < end && std::isspace(static_cast<unsigned char>(text[i]))) {
+                            ++i;
+                        }
+                        size_t start = i;
+                        while (i < end && !std::isspace(static_cast<unsigned char>(text[i]))) {
+                            ++i;
+                        }
+                        if (i > start) {
+                            libraries.push_back((directory / string(text + start, i - start)).generic_string());
+                        }
+                    }
+                }
+                line = end + 1;
+            }
+            return libraries;
+        }
+    }  // namespace
+
+    string cachePath(const string& model_path)
+    {
+        return model_path + ".meshcache";
+    }
+
+    bool makeKey(const string& model_path, uint32_t import_flags, Key& key)
+    {
+        MappedFile source;
+        if (!source.open(model_path.c_str())) {
+            return false;
+        }
+        key.source_hash = fnv1a(source.data(), source.size());
+        string extension = std::filesystem::path(model_path).extension().string();
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        if (extension == ".obj") {
+            // A missing library still counts by name, so creating it later invalidates the cache too.
+            for (const string& library : materialLibraries(model_path, source.data(), source.size())) {
+                key.source_hash = fnv1a(library.data(), library.size(), key.source_hash);
+                MappedFile material;
+                if (material.open(library.c_str())) {
+                    key.source_hash = fnv1a(material.data(), material.size(), key.source_hash);
+                }
+            }
+        }
+        key.import_flags = import_flags;
+        return true;
+    }
+
+    bool Reader::open(const string& cache_path, const Key& key)
+    {
+        meshes_.clear();
+        indices_.clear();
+        scene_.clear();
+        instances_.clear();
+        if (!file_.open(cache_path.c_str())) {
+            return false;
+        }
+
+        Cursor cursor(file_.data(), file_.size());
+        FileHeader header;
+        if (!cursor.read(header) || header.magic != MAGIC || header.version != VERSION ||
+            header.vertex_size != sizeof(Vertex) || header.source_hash != key.source_hash ||
+            header.import_flags != key.import_flags) {
+            file_.close();
+            return false;
+        }
+
+        meshes_.resize(header.mesh_count);
+        indices_.resize(header.mesh_count);
+        bool valid = true;
+        for (uint32_t i = 0; i < header.mesh_count && valid; ++i) {
+            valid = readMesh(cursor, meshes_[i], indices_[i]);
+        }
+        if (!valid || !readScene(cursor, meshes_.size(), scene_, instances_)) {
+            std::cout << "ERROR::MESH_CACHE::INVALID_FILE " << cache_path << std::endl;
+            meshes_.clear();
+            indices_.clear();
+            scene_.clear();
+            instances_.clear();
+            file_.close();
+            return false;
+        }
+        return true;
+    }
+
+    bool write(const string& cache_path, const Key& key, const vector<CookedMesh>& meshes, const SceneGraph& scene,
+               const vector<MeshInstance>& instances)
+    {
+        // Written under a temporary name and renamed, so readers still mapping the old file keep valid data and a
+        // crash never leaves a truncated cache behind. The name is unique per write because several loads of one
+        // model may write at the same time.
+        static std::atomic<uint32_t> write_count{0};
+        string temporary = cache_path + "." + std::to_string(write_count++) + ".tmp";
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            return false;
+        }
+
+        FileHeader header = {};
+        header.magic = MAGIC;
+        header.version = VERSION;
+        header.source_hash = key.source_hash;
+        header.import_flags = key.import_flags;
+        header.vertex_size = sizeof(Vertex);
+        header.mesh_count = static_cast<uint32_t>(meshes.size());
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        vector<unsigned char> encoded;
+        for (const CookedMesh& mesh : meshes) {
+            IndexBuffer::encode(mesh.indices, mesh.index_count, encoded);
+
+            MeshHeader mesh_header = {};
+            mesh_header.vertex_count = mesh.vertex_count;
+            mesh_header.index_count = mesh.index_count;
+            mesh_header.chunk_count = static_cast<uint32_t>(mesh.chunks.size());
+            mesh_header.encoded_index_size = static_cast<uint32_t>(encoded.size());
+            mesh_header.texture_count = static_cast<uint32_t>(mesh.textures.size());
+            mesh_header.lod_count = static_cast<uint32_t>(mesh.lods.size());
+            mesh_header.meshlet_count = static_cast<uint32_t>(mesh.meshlets.size());
+            out.write(reinterpret_cast<const char*>(&mesh_header), sizeof(mesh_header));
+            out.write(reinterpret_cast<const char*>(&mesh.optimization), sizeof(mesh.optimization));
+            out.write(reinterpret_cast<const char*>(mesh.vertices), size_t(mesh.vertex_count) * sizeof(Vertex));
+            out.write(reinterpret_cast<const char*>(mesh.chunks.data()),
+                      mesh.chunks.size() * sizeof(IndexBuffer::Chunk));
+            out.write(reinterpret_cast<const char*>(mesh.lods.data()), mesh.lods.size() * sizeof(IndexBuffer::Lod));
+            out.write(reinterpret_cast<const char*>(mesh.meshlets.data()),
+                      mesh.meshlets.size() * sizeof(Meshlets::Meshlet));
+            out.write(reinterpret_cast<const char*>(encoded.data()), encoded.size());
+
+            for (const TextureRef& texture : mesh.textures) {
+                uint32_t fields[2] = {static_cast<uint32_t>(texture.role), static_cast<uint32_t>(texture.path.size())};
+                out.write(reinterpret_cast<const char*>(fields), sizeof(fields));
+                out.write(texture.path.data(), fields[1]);
+            }
+            writePadding(out);
+        }
+
+        SceneHeader scene_header = {static_cast<uint32_t>(scene.size()), static_cast<uint32_t>(instances.size())};
+        out.write(reinterpret_cast<const char*>(&scene_header), sizeof(scene_header));
+        out.write(reinterpret_cast<const char*>(scene.parents().data()), scene.size() * sizeof(int32_t));
+        out.write(reinterpret_cast<const char*>(scene.localTransforms().data()), scene.size() * sizeof(glm::mat4));
+        out.write(reinterpret_cast<const char*>(instances.data()), instances.size() * sizeof(MeshInstance));
+        out.close();
+
+        std::error_code error;
+        if (out) {
+            // Fails on Windows while another load still maps the old file, the next cold load tries again.
+            std::filesystem::rename(temporary, cache_path, error);
+        }
+        if (!out || error) {
+            std::filesystem::remove(temporary, error);
+            return false;
+        }
+        return true;
+    }
+}  // namespace MeshCache
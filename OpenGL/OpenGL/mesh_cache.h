@@ -0,0 +1,75 @@
+#pragma once
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "index_buffer.h"
+#include "mapped_file.h"
+#include "mesh.h"
+#include "mesh_optimizer.h"
+#include "meshlet.h"
+#include "scene_graph.h"
+
+// Binary cache of the meshes cooked by Model::processMesh.
+// One "<model path>.meshcache" file per source model holds the converted vertex/index arrays and the texture
+// references of every mesh plus the node hierarchy that places them, so a warm load maps the file and uploads it
+// without building an aiScene.
+// Vertices are used straight from the mapping, the 16-bit indices are stored with IndexBuffer::encode and decoded
+// when the file is opened.
+namespace MeshCache {
+    // Bump whenever the file layout or the Vertex layout changes.
+    const uint32_t VERSION = 7;
+
+    struct Key {
+        uint64_t source_hash = 0;
+        uint32_t import_flags = 0;
+    };
+
+    struct TextureRef {
+        TextureRole role;
+        string path;
+    };
+
+    // View of a cooked mesh, either into a cache file (valid while its Reader is alive) or over freshly converted
+    // arrays.
+    struct CookedMesh {
+        const Vertex* vertices = nullptr;
+        uint32_t vertex_count = 0;
+        const uint16_t* indices = nullptr;
+        uint32_t index_count = 0;
+        vector<IndexBuffer::Chunk> chunks;
+        vector<IndexBuffer::Lod> lods;  // Empty: one level over all chunks.
+        vector<Meshlets::Meshlet> meshlets;
+        vector<TextureRef> textures;
+        MeshOptimizer::Report optimization;
+    };
+
+    class Reader {
+    public:
+        // Fails when the file is missing, truncated, damaged or written for another key/version.
+        bool open(const string& cache_path, const Key& key);
+        const vector<CookedMesh>& meshes() const { return meshes_; }
+        const SceneGraph& scene() const { return scene_; }
+        const vector<MeshInstance>& instances() const { return instances_; }
+
+    private:
+        MappedFile file_;
+        vector<CookedMesh> meshes_;
+        vector<vector<uint16_t>> indices_;  // Decoded, per mesh.
+        SceneGraph scene_;
+        vector<MeshInstance> instances_;
+    };
+
+    string cachePath(const string& model_path);
+    // Hashes the source file, and for an .obj the material libraries it names, returns false if the model can't be
+    // read.
+    bool makeKey(const string& model_path, uint32_t import_flags, Key& key);
+    // Replaces the file atomically, readers that still map the previous version are unaffected.
+    bool write(const string& cache_path, const Key& key, const vector<CookedMesh>& meshes, const SceneGraph& scene,
+               const vector<MeshInstance>& instances);
+}  // namespace MeshCache
+
+#endif
@@ -0,0 +1,328 @@
+#include "mesh_optimizer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include "hash.h"
+
+namespace MeshOptimizer {
+    namespace {
+        // Forsyth's tuning constants.
+        const unsigned int FORSYTH_CACHE_SIZE = 32;
+        const float CACHE_DECAY_POWER = 1.5f;
+        const float LAST_TRIANGLE_SCORE = 0.75f;
+        const float VALENCE_BOOST_SCALE = 2.0f;
+        const float VALENCE_BOOST_POWER = 0.5f;
+
+        float vertexScore(int cache_position, unsigned int live_triangles)
+        {
+            // No triangles left to draw.
+            if (live_triangles == 0) {
+                return -1.0f;
+            }
+            float score = 0.0f;
+            if (cache_position >= 0) {
+                // The triangle just drawn gets a fixed score so the next one doesn't just reuse its edge.
+                if (cache_position < 3) {
+                    score = LAST_TRIANGLE_SCORE;
+                } else {
+                    float scale = 1.0f / (FORSYTH_CACHE_SIZE - 3);
+                    score = std::pow(1.0f - (cache_position - 3) * scale, CACHE_DECAY_POWER);
+                }
+            }
+            // Finish off vertices with few triangles left so they leave the working set.
+            score += VALENCE_BOOST_SCALE * std::pow(float(live_triangles), -VALENCE_BOOST_POWER);
+            return score;
+        }
+
+        glm::vec3 triangleNormal(const std::vector<Vertex>& vertices, const unsigned int* triangle)
+        {
+            const glm::vec3& a = vertices[triangle[0]].position;
+            return glm::cross(vertices[triangle[1]].position - a, vertices[triangle[2]].position - a);
+        }
+    }  // namespace
+
+    CacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertex_count,
+                                  unsigned int cache_size)
+    {
+        CacheStats stats;
+        if (indices.empty() || vertex_count == 0) {
+            return stats;
+        }
+
+        // FIFO: a vertex stays cached until `cache_size` misses happened after its own.
+        std::vector<size_t> cached_at(vertex_count, 0);
+        std::vector<bool> used(vertex_count, false);
+        size_t misses = 0;
+        size_t unique = 0;
+        for (unsigned int index : indices) {
+            if (!used[index]) {
+                used[index] = true;
+                ++unique;
+            } else if (misses - cached_at[index] < cache_size) {
+                continue;
+            }
+            cached_at[index] = misses++;
+        }
+
+        stats.acmr = float(misses) / float(indices.size() / 3);
+        stats.atvr = float(misses) / float(unique);
+        return stats;
+    }
+
+    size_t weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+    {
+        // Open-addressing table of unique vertex ids, sized to stay at most half full.
+        size_t table_size = 1;
+        while (table_size < vertices.size() * 2) {
+            table_size *= 2;
+        }
+        const unsigned int EMPTY = ~0u;
+        std::vector<unsigned int> table(table_size, EMPTY);
+
+        std::vector<unsigned int> remap(vertices.size());
+        std::vector<Vertex> unique;
+        unique.reserve(vertices.size());
+        for (size_t i = 0; i < vertices.size(); ++i) {
+            size_t slot = fnv1a(&vertices[i], sizeof(Vertex)) & (table_size - 1);
+            while (table[slot] != EMPTY && std::memcmp(&unique[table[slot]], &vertices[i], sizeof(Vertex)) != 0) {
+                slot = (slot + 1) & (table_size - 1);
+            }
+            if (table[slot] == EMPTY) {
+                table[slot] = static_cast<unsigned int>(unique.size());
+                unique.push_back(vertices[i]);
+            }
+            remap[i] = table[slot];
+        }
+
+        for (unsigned int& index : indices) {
+            index = remap[index];
+        }
+        size_t removed = vertices.size() - unique.size();
+        vertices.swap(unique);
+        return removed;
+    }
+
+    void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count)
+    {
+        size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) {
+            return;
+        }
+
+        // Triangles around each vertex, as ranges into one array.
+        std::vector<unsigned int> live(vertex_count, 0);
+        for (unsigned int index : indices) {
+            ++live[index];
+        }
+        std::vector<unsigned int> first(vertex_count + 1, 0);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            first[v + 1] = first[v] + live[v];
+        }
+        std::vector<unsigned int> adjacency(indices.size());
+        std::vector<unsigned int> filled(first.begin(), first.end() - 1);
+        for (size_t i = 0; i < indices.size(); ++i) {
+            adjacency[filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+        }
+
+        std::vector<int> cache_position(vertex_count, -1);
+        std::vector<float> vertex_scores(vertex_count);
+        for (size_t v = 0; v < vertex_count; ++v) {
+            vertex_scores[v] = vertexScore(-1, live[v]);
+        }
+        std::vector<float> triangle_scores(triangle_count);
+        std::vector<bool> emitted(triangle_count, false);
+        for (size_t t = 0; t < triangle_count; ++t) {
+            triangle_scores[t] = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] +
+                                 vertex_scores[indices[t * 3 + 2]];
+        }
+
+        std::vector<unsigned int> output;
+        output.reserve(indices.size());
+        std::vector<unsigned int> cache;
+        std::vector<unsigned int> next_cache;
+        size_t best = std::max_element(triangle_scores.begin(), triangle_scores.end()) - triangle_scores.begin();
+        size_t scan = 0;  // Fallback cursor once the cache runs dry.
+
+        while (output.size() < indices.size()) {
+            emitted[best] = true;
+            const unsigned int* triangle = &indices[best * 3];
+            output.insert(output.end(), triangle, triangle + 3);
+
+            // Drop the triangle from its vertices' adjacency.
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = triangle[k];
+                unsigned int* begin = &adjacency[first[v]];
+                unsigned int* end = begin + live[v];
+                *std::find(begin, end, static_cast<unsigned int>(best)) = *(end - 1);
+                --live[v];
+            }
+
+            // Move the triangle's vertices to the front of the LRU cache.
+            next_cache.assign(triangle, triangle + 3);
+            for (unsigned int v : cache) {
+                if (v != triangle[0] && v != triangle[1] && v != triangle[2]) {
+                    next_cache.push_back(v);
+                }
+            }
+            // Vertices pushed out of the cache lose their position score.
+            for (size_t i = FORSYTH_CACHE_SIZE; i < next_cache.size(); ++i) {
+                cache_position[next_cache[i]] = -1;
+                vertex_scores[next_cache[i]] = vertexScore(-1, live[next_cache[i]]);
+            }
+            if (next_cache.size() > FORSYTH_CACHE_SIZE) {
+                next_cache.resize(FORSYTH_CACHE_SIZE);
+            }
+            cache.swap(next_cache);
+
+            for (size_t i = 0; i < cache.size(); ++i) {
+                cache_position[cache[i]] = static_cast<int>(i);
+                vertex_scores[cache[i]] = vertexScore(static_cast<int>(i), live[cache[i]]);
+            }
+
+            // Only triangles touching the cache changed score, the best next one is among them.
+            float best_score = -1.0f;
+            for (unsigned int v : cache) {
+                for (unsigned int i = 0; i < live[v]; ++i) {
+                    unsigned int t = adjacency[first[v] + i];
+                    float score = vertex_scores[indices[t * 3]] + vertex_scores[indices[t * 3 + 1]] +
+                                  vertex_scores[indices[t * 3 + 2]];
+                    if (score > best_score) {
+                        best_score = score;
+                        best = t;
+                    }
+                }
+            }
+            if (best_score < 0.0f) {
+                while (scan < triangle_count && emitted[scan]) {
+                    ++scan;
+                }
+                best = scan;
+            }
+        }
+        indices.swap(output);
+    }
+
+    void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, float threshold)
+    {
+        size_t triangle_count = indices.size() / 3;
+        if (triangle_count < 2) {
+            return;
+        }
+
+        // Misses per triangle in the FIFO cache, a triangle missing all three vertices is where the cache restarted.
+        std::vector<size_t> cached_at(vertices.size(), 0);
+        std::vector<bool> used(vertices.size(), false);
+        std::vector<unsigned int> misses(triangle_count, 0);
+        size_t total_misses = 0;
+        for (size_t t = 0; t < triangle_count; ++t) {
+            for (int k = 0; k < 3; ++k) {
+                unsigned int v = indices[t * 3 + k];
+                if (used[v] && total_misses - cached_at[v] < FIFO_CACHE_SIZE) {
+                    continue;
+                }
+                used[v] = true;
+                cached_at[v] = total_misses++;
+                ++misses[t];
+            }
+        }
+        float target_acmr = threshold * float(total_misses) / float(triangle_count);
+
+        // Start a cluster at a restart once the current one is at least as cache-friendly as the target.
+        std::vector<size_t> cluster_starts(1, 0);
+        size_t cluster_misses = 0;
+        for (size_t t = 0; t < triangle_count; ++t) {
+            size_t cluster_size = t - cluster_starts.back();
+            if (misses[t] == 3 && cluster_size > 0 && float(cluster_misses) / float(cluster_size) <= target_acmr) {
+                cluster_starts.push_back(t);
+                cluster_misses = 0;
+            }
+            cluster_misses += misses[t];
+        }
+        if (cluster_starts.size() < 2) {
+            return;
+        }
+        cluster_starts.push_back(triangle_count);
+
+        // Area-weighted centroid of the whole mesh.
+        glm::vec3 mesh_centroid(0.0f);
+        float mesh_area = 0.0f;
+        for (size_t t = 0; t < triangle_count; ++t) {
+            const unsigned int* triangle = &indices[t * 3];
+            float area = glm::length(triangleNormal(vertices, triangle));
+            mesh_centroid += area * (vertices[triangle[0]].position + vertices[triangle[1]].position +
+                                     vertices[triangle[2]].position) / 3.0f;
+            mesh_area += area;
+        }
+        mesh_centroid /= std::max(mesh_area, 1e-20f);
+
+        // Clusters facing away from the centre occlude the ones behind them, so they draw first.
+        struct Cluster {
+            size_t begin;
+            size_t end;
+            float sort_key;
+        };
+        std::vector<Cluster> clusters;
+        for (size_t c = 0; c + 1 < cluster_starts.size(); ++c) {
+            glm::vec3 centroid(0.0f);
+            glm::vec3 normal(0.0f);
+            float area = 0.0f;
+            for (size_t t = cluster_starts[c]; t < cluster_starts[c + 1]; ++t) {
+                const unsigned int* triangle = &indices[t * 3];
+                glm::vec3 n = triangleNormal(vertices, triangle);
+                float a = glm::length(n);
+                centroid += a * (vertices[triangle[0]].position + vertices[triangle[1]].position +
+                                 vertices[triangle[2]].position) / 3.0f;
+                normal += n;
+                area += a;
+            }
+            centroid /= std::max(area, 1e-20f);
+            float normal_length = glm::length(normal);
+            float key = normal_length > 0.0f ? glm::dot(centroid - mesh_centroid, normal / normal_length) : 0.0f;
+            clusters.push_back({cluster_starts[c], cluster_starts[c + 1], key});
+        }
+        std::stable_sort(clusters.begin(), clusters.end(),
+                         [](const Cluster& a, const Cluster& b) { return a.sort_key > b.sort_key; });
+
+        std::vector<unsigned int> output;
+        output.reserve(indices.size());
+        for (const Cluster& cluster : clusters) {
+            output.insert(output.end(), indices.begin() + cluster.begin * 3, indices.begin() + cluster.end * 3);
+        }
+        indices.swap(output);
+    }
+
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+    {
+        const unsigned int UNUSED = ~0u;
+        std::vector<unsigned int> remap(vertices.size(), UNUSED);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+        for (unsigned int& index : indices) {
+            if (remap[index] == UNUSED) {
+                remap[index] = static_cast<unsigned int>(ordered.size());
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        // Vertices no triangle references are dropped.
+        vertices.swap(ordered);
+    }
+
+    Report optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+    {
+        Report report;
+        report.source_vertex_count = static_cast<uint32_t>(vertices.size());
+        report.before = analyzeVertexCache(indices, vertices.size());
+
+        weldVertices(vertices, indices);
+        optimizeVertexCache(indices, vertices.size());
+        optimizeOverdraw(indices, vertices);
+        optimizeVertexFetch(vertices, indices);
+
+        report.vertex_count = static_cast<uint32_t>(vertices.size());
+        report.after = analyzeVertexCache(indices, vertices.size());
+        return report;
+    }
+}  // namespace MeshOptimizer
@@ -0,0 +1,46 @@
+#pragma once
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <cstdint>
+#include <vector>
+
+#include "mesh.h"
+
+// Import-time reordering of indexed triangle lists, run by Model on every cold import.
+namespace MeshOptimizer {
+    // Post-transform cache behaviour of an index buffer, simulated with a FIFO cache.
+    struct CacheStats {
+        float acmr = 0.0f;  // Vertex transforms per triangle, 0.5 is the ideal for large meshes, 3 the worst.
+        float atvr = 0.0f;  // Vertex transforms per unique vertex, 1 is the ideal.
+    };
+
+    // What optimize() did to a mesh. Stored in the mesh cache, so keep it plain data.
+    struct Report {
+        uint32_t source_vertex_count = 0;
+        uint32_t vertex_count = 0;
+        CacheStats before;
+        CacheStats after;
+    };
+
+    const unsigned int FIFO_CACHE_SIZE = 16;
+
+    CacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertex_count,
+                                  unsigned int cache_size = FIFO_CACHE_SIZE);
+
+    // Merges bit-identical vertices and rewrites the indices, returns how many were removed.
+    size_t weldVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+    // Reorders triangles for post-transform cache hits (Forsyth's linear-speed algorithm).
+    void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertex_count);
+    // Splits the cache-ordered triangles into clusters at cache restarts and sorts the clusters so outward-facing
+    // ones come first (Sander et al.). `threshold` bounds how much worse than the input ACMR a cluster may get.
+    void optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices,
+                          float threshold = 1.05f);
+    // Renumbers the vertices in first-use order so fetches walk the vertex buffer forwards.
+    void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+    // All of the above in order. Indices must be a triangle list.
+    Report optimize(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+}  // namespace MeshOptimizer
+
+#endif
@@ -0,0 +1,309 @@
+#include "mesh_simplifier.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include "hash.h"
+#include "mesh_optimizer.h"
+
+namespace MeshSimplifier {
+    namespace {
+        // Sum of squared distances to a set of planes, weighted by the area of the triangles they came from.
+        struct Quadric {
+            double a2 = 0, ab = 0, ac = 0, ad = 0;
+            double b2 = 0, bc = 0, bd = 0;
+            double c2 = 0, cd = 0;
+            double d2 = 0;
+            double weight = 0;
+
+            void addPlane(const glm::dvec3& n, double d, double w)
+            {
+                a2 += w * n.x * n.x;
+                ab += w * n.x * n.y;
+                ac += w * n.x * n.z;
+                ad += w * n.x * d;
+                b2 += w * n.y * n.y;
+                bc += w * n.y * n.z;
+                bd += w * n.y * d;
+                c2 += w * n.z * n.z;
+                cd += w * n.z * d;
+                d2 += w * d * d;
+                weight += w;
+            }
+
+            void add(const Quadric& q)
+            {
+                a2 += q.a2;
+                ab += q.ab;
+                ac += q.ac;
+                ad += q.ad;
+                b2 += q.b2;
+                bc += q.bc;
+                bd += q.bd;
+                c2 += q.c2;
+                cd += q.cd;
+                d2 += q.d2;
+                weight += q.weight;
+            }
+
+            // Mean squared distance of p to the planes.
+            double error(const glm::vec3& p) const
+            {
+                double x = p.x, y = p.y, z = p.z;
+                double e = a2 * x * x + b2 * y * y + c2 * z * z + 2 * (ab * x * y + ac * x * z + bc * y * z) +
+                           2 * (ad * x + bd * y + cd * z) + d2;
+                return weight > 0 ? std::max(e, 0.0) / weight : 0.0;
+            }
+        };
+
+        struct Collapse {
+            unsigned int from;
+            unsigned int to;
+            double cost;
+        };
+
+        // One id per distinct position, so the quadrics of seam vertices are shared.
+        std::vector<unsigned int> positionIds(const std::vector<Vertex>& vertices, std::vector<unsigned int>& counts)
+        {
+            size_t table_size = 1;
+            while (table_size < vertices.size() * 2) {
+                table_size *= 2;
+            }
+            const unsigned int EMPTY = ~0u;
+            std::vector<unsigned int> table(table_size, EMPTY);
+            std::vector<unsigned int> ids(vertices.size());
+            counts.clear();
+            for (size_t i = 0; i < vertices.size(); ++i) {
+                const glm::vec3& position = vertices[i].position;
+                size_t slot = fnv1a(&position, sizeof(position)) & (table_size - 1);
+                while (table[slot] != EMPTY &&
+                       std::memcmp(&vertices[table[slot]].position, &position, sizeof(position)) != 0) {
+                    slot = (slot + 1) & (table_size - 1);
+                }
+                if (table[slot] == EMPTY) {
+                    table[slot] = static_cast<unsigned int>(i);
+                    counts.push_back(0);
+                }
+                ids[i] = table[slot] == i ? static_cast<unsigned int>(counts.size() - 1) : ids[table[slot]];
+                ++counts[ids[i]];
+            }
+            return ids;
+        }
+
+        glm::vec3 faceNormal(const glm::vec3& a, const glm::vec3& b, const glm::vec3& c)
+        {
+            return glm::cross(b - a, c - a);
+        }
+    }  // namespace
+
+    std::vector<unsigned int> simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                       size_t target_index_count, float max_error, float& error)
+    {
+        error = 0.0f;
+        std::vector<unsigned int> result = indices;
+        if (result.size() <= target_index_count || vertices.empty()) {
+            return result;
+        }
+
+        std::vector<unsigned int> position_counts;
+        std::vector<unsigned int> position_id = positionIds(vertices, position_counts);
+
+        // Seam vertices are locked, border vertices too: edges used by a single triangle.
+        std::vector<bool> locked(vertices.size(), false);
+        std::vector<bool> locked_position(position_counts.size(), false);
+        std::unordered_map<uint64_t, unsigned int> edge_uses;
+        edge_uses.reserve(result.size());
+        for (size_t i = 0; i < result.size(); i += 3) {
+            for (int k = 0; k < 3; ++k) {
+                uint64_t a = position_id[result[i + k]];
+                uint64_t b = position_id[result[i + (k + 1) % 3]];
+                ++edge_uses[a < b ? (a << 32) | b : (b << 32) | a];
+            }
+        }
+        for (const auto& edge : edge_uses) {
+            if (edge.second == 1) {
+                locked_position[edge.first >> 32] = true;
+                locked_position[edge.first & 0xffffffffu] = true;
+            }
+        }
+        for (size_t v = 0; v < vertices.size(); ++v) {
+            locked[v] = position_counts[position_id[v]] > 1 || locked_position[position_id[v]];
+        }
+
+        std::vector<Quadric> quadrics(position_counts.size());
+        for (size_t i = 0; i < result.size(); i += 3) {
+            glm::dvec3 a = vertices[result[i]].position;
+            glm::dvec3 n = glm::cross(glm::dvec3(vertices[result[i + 1]].position) - a,
+                                      glm::dvec3(vertices[result[i + 2]].position) - a);
+            double area = glm::length(n);
+            if (area == 0.0) {
+                continue;
+            }
+            n /= area;
+            for (int k = 0; k < 3; ++k) {
+                quadrics[position_id[result[i + k]]].addPlane(n, -glm::dot(n, a), area);
+            }
+        }
+
+        double max_cost = double(max_error) * max_error;
+        double taken_cost = 0.0;
+        std::vector<unsigned int> remap(vertices.size());
+        std::vector<bool> touched(vertices.size());
+        std::vector<unsigned int> adjacency_first(vertices.size() + 1);
+        std::vector<unsigned int> adjacency;
+        std::vector<Collapse> collapses;
+
+        // Passes of independent collapses: each one only touches vertices no earlier collapse in the pass changed.
+        while (result.size() > target_index_count) {
+            size_t triangle_count = result.size() / 3;
+
+            collapses.clear();
+            for (size_t i = 0; i < result.size(); i += 3) {
+                for (int k = 0; k < 3; ++k) {
+                    unsigned int a = result[i + k];
+                    unsigned int b = result[i + (k + 1) % 3];
+                    Quadric q = quadrics[position_id[a]];
+                    q.add(quadrics[position_id[b]]);
+                    if (!locked[a]) {
+                        collapses.push_back({a, b, q.error(vertices[b].position)});
+                    }
+                    if (!locked[b]) {
+                        collapses.push_back({b, a, q.error(vertices[a].position)});
+                    }
+                }
+            }
+            std::sort(collapses.begin(), collapses.end(),
+                      [](const Collapse& x, const Collapse& y) { return x.cost < y.cost; });
+
+            // Triangles around every vertex, for the flip test.
+            std::fill(adjacency_first.begin(), adjacency_first.end(), 0);
+            for (unsigned int index : result) {
+                ++adjacency_first[index + 1];
+            }
+            for (size_t v = 0; v < vertices.size(); ++v) {
+                adjacency_first[v + 1] += adjacency_first[v];
+            }
+            adjacency.resize(result.size());
+            std::vector<unsigned int> fill(adjacency_first.begin(), adjacency_first.end() - 1);
+            for (size_t i = 0; i < result.size(); ++i) {
+                adjacency[fill[result[i]]++] = static_cast<unsigned int>(i / 3);
+            }
+
+            for (size_t v = 0; v < vertices.size(); ++v) {
+                remap[v] = static_cast<unsigned int>(v);
+            }
+            std::fill(touched.begin(), touched.end(), false);
+
+            // Each collapse removes about two triangles.
+            size_t wanted = (triangle_count - target_index_count / 3 + 1) / 2;
+            size_t done = 0;
+            for (const Collapse& collapse : collapses) {
+                if (done >= wanted || collapse.cost > max_cost) {
+                    break;
+                }
+                if (touched[collapse.from] || touched[collapse.to]) {
+                    continue;
+                }
+
+                // Reject collapses that would flip or degenerate a remaining triangle.
+                bool flips = false;
+                const glm::vec3& target = vertices[collapse.to].position;
+                for (unsigned int a = adjacency_first[collapse.from]; a < adjacency_first[collapse.from + 1]; ++a) {
+                    const unsigned int* triangle = &result[adjacency[a] * 3];
+                    if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to) {
+                        continue;
+                    }
+                    glm::vec3 corners[3];
+                    glm::vec3 moved[3];
+                    for (int k = 0; k < 3; ++k) {
+                        corners[k] = vertices[triangle[k]].position;
+                        moved[k] = triangle[k] == collapse.from ? target : corners[k];
+                    }
+                    glm::vec3 before = faceNormal(corners[0], corners[1], corners[2]);
+                    glm::vec3 after = faceNormal(moved[0], moved[1], moved[2]);
+                    // Tilting a face by more than ~75 degrees counts as a flip as well, on a curved surface that
+                    // is usually enough to turn it inside out relative to its neighbours.
+                    if (glm::dot(before, after) <= 0.25f * glm::length(before) * glm::length(after)) {
+                        flips = true;
+                        break;
+                    }
+                }
+                if (flips) {
+                    continue;
+                }
+
+                // Freeze the one-ring so later collapses in this pass see up to date geometry.
+                for (unsigned int a = adjacency_first[collapse.from]; a < adjacency_first[collapse.from + 1]; ++a) {
+                    const unsigned int* triangle = &result[adjacency[a] * 3];
+                    touched[triangle[0]] = touched[triangle[1]] = touched[triangle[2]] = true;
+                }
+                remap[collapse.from] = collapse.to;
+                quadrics[position_id[collapse.to]].add(quadrics[position_id[collapse.from]]);
+                taken_cost = std::max(taken_cost, collapse.cost);
+                ++done;
+            }
+            if (done == 0) {
+                break;
+            }
+
+            // Apply the pass and drop the triangles that collapsed.
+            size_t write = 0;
+            for (size_t i = 0; i < result.size(); i += 3) {
+                unsigned int a = remap[result[i]];
+                unsigned int b = remap[result[i + 1]];
+                unsigned int c = remap[result[i + 2]];
+                if (a != b && b != c && a != c) {
+                    result[write++] = a;
+                    result[write++] = b;
+                    result[write++] = c;
+                }
+            }
+            result.resize(write);
+        }
+
+        error = static_cast<float>(std::sqrt(taken_cost));
+        return result;
+    }
+
+    void buildLodChain(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                       std::vector<std::vector<unsigned int>>& lods, std::vector<float>& errors, size_t max_lods)
+    {
+        lods.clear();
+        errors.clear();
+
+        // Allow errors up to a fifth of the mesh size, the target triangle counts are what bounds each level.
+        glm::vec3 min_position(0.0f);
+        glm::vec3 max_position(0.0f);
+        if (!vertices.empty()) {
+            min_position = max_position = vertices[0].position;
+        }
+        for (const Vertex& vertex : vertices) {
+            min_position = glm::min(min_position, vertex.position);
+            max_position = glm::max(max_position, vertex.position);
+        }
+        glm::vec3 extent = max_position - min_position;
+        float max_error = 0.2f * std::max(extent.x, std::max(extent.y, extent.z));
+
+        size_t previous_count = indices.size();
+        float previous_error = 0.0f;
+        for (size_t level = 1; level <= max_lods; ++level) {
+            size_t target = (indices.size() >> level) / 3 * 3;
+            if (target < 3 * 16) {
+                break;
+            }
+            float error = 0.0f;
+            std::vector<unsigned int> lod = simplify(vertices, indices, target, max_error, error);
+            // Not worth a level if it barely differs from the previous one.
+            if (lod.size() * 100 > previous_count * 85) {
+                break;
+            }
+            MeshOptimizer::optimizeVertexCache(lod, vertices.size());
+            previous_error = std::max(previous_error, error);
+            previous_count = lod.size();
+            lods.push_back(std::move(lod));
+            errors.push_back(previous_error);
+        }
+    }
+}  // namespace MeshSimplifier
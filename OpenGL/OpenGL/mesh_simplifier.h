@@ -0,0 +1,26 @@
+#pragma once
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+
+#include "mesh.h"
+
+// Quadric error metric simplification (Garland & Heckbert) by collapsing edges onto one of their existing
+// endpoints, so every level of detail indexes the original vertex buffer.
+// Vertices on borders and attribute seams (several vertices at one position) are never removed, which keeps the
+// silhouette and the texture mapping intact at the cost of less reduction on heavily seamed meshes.
+namespace MeshSimplifier {
+    // Collapses edges, cheapest first, until at most `target_index_count` indices are left or the next collapse
+    // would move the surface by more than `max_error` (model units). `error` receives the largest error taken.
+    std::vector<unsigned int> simplify(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                                       size_t target_index_count, float max_error, float& error);
+
+    // Levels of detail after the full mesh, each aiming at half the triangles of the previous one. Stops early once
+    // a level no longer removes enough triangles. Errors are in model units and never decrease along the chain.
+    void buildLodChain(const std::vector<Vertex>& vertices, const std::vector<unsigned int>& indices,
+                       std::vector<std::vector<unsigned int>>& lods, std::vector<float>& errors,
+                       size_t max_lods = 4);
+}  // namespace MeshSimplifier
+
+#endif
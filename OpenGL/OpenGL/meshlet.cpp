@@ -0,0 +1,124 @@
+#include "meshlet.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "mesh.h"
+
+namespace Meshlets {
+    void build(const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices,
+               const std::vector<IndexBuffer::Chunk>& chunks, std::vector<Meshlet>& meshlets)
+    {
+        meshlets.clear();
+        // Distinct vertices of the open meshlet, valid while their stamp is its number.
+        std::vector<uint32_t> stamp(IndexBuffer::MAX_CHUNK_VERTICES, ~0u);
+        uint32_t meshlet_id = 0;
+
+        for (uint32_t c = 0; c < chunks.size(); ++c) {
+            const IndexBuffer::Chunk& chunk = chunks[c];
+            Meshlet meshlet;
+            meshlet.chunk = c;
+            meshlet.first_index = chunk.first_index;
+            size_t vertex_count = 0;
+
+            auto close = [&]() {
+                computeBounds(vertices.data() + chunk.base_vertex, indices.data(), meshlet);
+                meshlets.push_back(meshlet);
+                meshlet.first_index += meshlet.index_count;
+                meshlet.index_count = 0;
+                vertex_count = 0;
+                ++meshlet_id;
+            };
+
+            for (uint32_t t = chunk.first_index; t + 2 < chunk.first_index + chunk.index_count; t += 3) {
+                size_t new_vertices = 0;
+                for (int k = 0; k < 3; ++k) {
+                    new_vertices += stamp[indices[t + k]] != meshlet_id ? 1 : 0;
+                }
+                if (vertex_count + new_vertices > MAX_VERTICES || meshlet.index_count / 3 >= MAX_TRIANGLES) {
+                    close();
+                    new_vertices = 3;
+                }
+                for (int k = 0; k < 3; ++k) {
+                    stamp[indices[t + k]] = meshlet_id;
+                }
+                vertex_count += new_vertices;
+                meshlet.index_count += 3;
+            }
+            if (meshlet.index_count > 0) {
+                close();
+            }
+        }
+    }
+
+    void computeBounds(const Vertex* vertices, const uint16_t* indices, Meshlet& meshlet)
+    {
+        const uint16_t* begin = indices + meshlet.first_index;
+        const uint16_t* end = begin + meshlet.index_count;
+        if (begin == end) {
+            return;
+        }
+
+        // Sphere around the box of the vertices.
+        glm::vec3 min_position = vertices[*begin].position;
+        glm::vec3 max_position = min_position;
+        for (const uint16_t* i = begin; i != end; ++i) {
+            min_position = glm::min(min_position, vertices[*i].position);
+            max_position = glm::max(max_position, vertices[*i].position);
+        }
+        meshlet.center = (min_position + max_position) * 0.5f;
+        meshlet.radius = 0.0f;
+        for (const uint16_t* i = begin; i != end; ++i) {
+            meshlet.radius = std::max(meshlet.radius, glm::length(vertices[*i].position - meshlet.center));
+        }
+
+        // Cone around the face normals, as in meshoptimizer's meshopt_computeMeshletBounds.
+        std::vector<glm::vec3> normals;
+        normals.reserve(meshlet.index_count / 3);
+        glm::vec3 axis(0.0f);
+        for (const uint16_t* i = begin; i != end; i += 3) {
+            const glm::vec3& a = vertices[i[0]].position;
+            glm::vec3 n = glm::cross(vertices[i[1]].position - a, vertices[i[2]].position - a);
+            float area = glm::length(n);
+            if (area > 0.0f) {
+                normals.push_back(n / area);
+                axis += normals.back();
+            }
+        }
+        meshlet.cone_apex = meshlet.center;
+        meshlet.cone_axis = glm::vec3(0.0f, 0.0f, 1.0f);
+        meshlet.cone_cutoff = 1.0f;
+        float axis_length = glm::length(axis);
+        if (normals.empty() || axis_length == 0.0f) {
+            return;
+        }
+        axis /= axis_length;
+
+        float min_dot = 1.0f;
+        for (const glm::vec3& n : normals) {
+            min_dot = std::min(min_dot, glm::dot(n, axis));
+        }
+        // Wider than ~85 degrees there is nearly no view direction left to cull from.
+        if (min_dot <= 0.1f) {
+            return;
+        }
+
+        // Move the apex back along the axis until it lies behind every triangle plane.
+        float max_t = 0.0f;
+        size_t face = 0;
+        for (const uint16_t* i = begin; i != end; i += 3) {
+            const glm::vec3& a = vertices[i[0]].position;
+            glm::vec3 n = glm::cross(vertices[i[1]].position - a, vertices[i[2]].position - a);
+            if (glm::length(n) == 0.0f) {
+                continue;
+            }
+            const glm::vec3& normal = normals[face++];
+            float dc = glm::dot(meshlet.center - a, normal);
+            float dn = glm::dot(axis, normal);
+            max_t = std::max(max_t, dc / dn);
+        }
+        meshlet.cone_apex = meshlet.center - axis * max_t;
+        meshlet.cone_axis = axis;
+        meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    }
+}  // namespace Meshlets
@@ -0,0 +1,42 @@
+#pragma once
+#ifndef MESHLET_H
+#define MESHLET_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm.hpp>
+
+#include "index_buffer.h"
+
+struct Vertex;
+
+// Clusters of a few dozen neighbouring triangles with the bounds needed to cull them one by one.
+namespace Meshlets {
+    const size_t MAX_VERTICES = 64;
+    const size_t MAX_TRIANGLES = 128;
+
+    // A run of triangles inside one chunk. The index range isn't reordered, so consecutive meshlets of a chunk
+    // can still be drawn as a single range.
+    struct Meshlet {
+        uint32_t chunk = 0;
+        uint32_t first_index = 0;  // Mesh relative, like Chunk::first_index.
+        uint32_t index_count = 0;
+        float radius = 0.0f;
+        glm::vec3 center = glm::vec3(0.0f);
+        // Normal cone: every triangle faces away from eyes in the cone behind the apex, see Culling::coneBackfacing.
+        glm::vec3 cone_apex = glm::vec3(0.0f);
+        glm::vec3 cone_axis = glm::vec3(0.0f);
+        float cone_cutoff = 1.0f;
+    };
+
+    // Cuts every chunk, in triangle order, into meshlets of at most MAX_VERTICES distinct vertices and
+    // MAX_TRIANGLES triangles. `vertices` is the chunked vertex array IndexBuffer::split produced.
+    void build(const std::vector<Vertex>& vertices, const std::vector<uint16_t>& indices,
+               const std::vector<IndexBuffer::Chunk>& chunks, std::vector<Meshlet>& meshlets);
+    // Fills in the bounds of a meshlet from the triangles it covers.
+    void computeBounds(const Vertex* vertices, const uint16_t* indices, Meshlet& meshlet);
+}  // namespace Meshlets
+
+#endif
@@ -1,167 +1,677 @@
 #include "model.h"
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <unordered_set>
+
+#include <gtc/type_ptr.hpp>
+
 #include "assimp/Importer.hpp"
 #include "assimp/postprocess.h"
-#include "stb_image.h"
+#include "mesh_simplifier.h"
+#include "string_table.h"
+#include "texture_cache.h"
+
+const unsigned int Model::IMPORT_FLAGS = aiProcess_Triangulate | aiProcess_FlipUVs;
 
 using std::cout;
 using std::endl;
 using std::string;
 using std::vector;
 
-static unsigned int textureFromFile(const char* path, const string& directory, bool gamma = false);
+// State shared by the stages of an async load.
+struct Model::AsyncLoad {
+    std::unique_ptr<Model> model;
+    string path;
+    Import import;
+    vector<string> texture_paths;
+    size_t uploads_left = 0;  // GL thread only.
+    std::promise<std::unique_ptr<Model>> promise;
+};
+
+Model::Model(const char* path, ThreadPool& pool, VertexFormat format)
+{
+    Import import;
+    if (!importModel(path, format, import, pool)) {
+        return;
+    }
+    directory_ = import.directory;
+    format_ = format;
+    scene_ = import.scene;
+    instances_ = import.instances;
+    loadMaterialTextures(import, pool);
+    createMeshes(import);
+}
+
+Model::~Model()
+{
+    releaseTextures();
+}
+
+Model::Model(Model&& other) noexcept : Model()
+{
+    *this = std::move(other);
+}
+
+Model& Model::operator=(Model&& other) noexcept
+{
+    if (this != &other) {
+        releaseTextures();
+        meshes_ = std::move(other.meshes_);
+        scene_ = std::move(other.scene_);
+        instances_ = std::move(other.instances_);
+        optimization_ = std::move(other.optimization_);
+        quantization_ = std::move(other.quantization_);
+        format_ = other.format_;
+        variant_defines_key_ = other.variant_defines_key_;
+        variant_defines_ = std::move(other.variant_defines_);
+        directory_ = std::move(other.directory_);
+        // The references move along, the source must not release them again.
+        textures_loaded_ = std::move(other.textures_loaded_);
+        other.textures_loaded_.clear();
+    }
+    return *this;
+}
+
+void Model::releaseTextures()
+{
+    for (const auto& texture : textures_loaded_) {
+        TextureCache::instance().release(texture.second);
+    }
+    textures_loaded_.clear();
+}
+
+std::future<std::unique_ptr<Model>> Model::loadAsync(const string& path, ThreadPool& pool, UploadQueue& uploads,
+                                                     VertexFormat format)
+{
+    auto load = std::make_shared<AsyncLoad>();
+    load->model.reset(new Model());
+    load->path = path;
+    std::future<std::unique_ptr<Model>> result = load->promise.get_future();
+
+    // Stage 4 (GL thread, once every texture is resident): one upload per mesh, then hand the model over. The
+    // queue runs in order, so the last task only runs after all meshes were created.
+    auto upload_meshes = [load, &uploads]() {
+        for (size_t i = 0; i < load->import.meshes.size(); ++i) {
+            const MeshCache::CookedMesh& mesh = load->import.meshes[i];
+            size_t bytes = mesh.vertex_count * vertexStride(load->import.format) + mesh.index_count * sizeof(uint16_t);
+            uploads.post([load, i]() { load->model->createMesh(load->import, i); }, bytes,
+                         load->path + " mesh " + std::to_string(i));
+        }
+        uploads.post([load]() { load->promise.set_value(std::move(load->model)); });
+    };
+
+    // Stage 3 (workers): decode each texture the cache doesn't have and post its upload, the last upload starts
+    // stage 4.
+    auto decode = [load, upload_meshes, &pool, &uploads](const vector<size_t>& missing) {
+        for (size_t i : missing) {
+            pool.submit([load, upload_meshes, &uploads, i]() {
+                string filename = load->model->directory_ + '/' + load->texture_paths[i];
+                auto decoded = std::make_shared<TextureCache::Decoded>(TextureCache::instance().decode(filename));
+                const TextureLoader::Image& image = decoded->image;
+                // Mipmaps add a third on top of the base level.
+                size_t bytes = size_t(image.width) * image.height * image.channels * 4 / 3;
+                uploads.post(
+                    [load, upload_meshes, decoded, filename, i]() {
+                        load->model->textures_loaded_[load->texture_paths[i]] =
+                            TextureCache::instance().insert(filename, *decoded);
+                        if (--load->uploads_left == 0) {
+                            upload_meshes();
+                        }
+                    },
+                    bytes, filename);
+            });
+        }
+    };
+
+    // Stage 1 (worker): parse or map the cache, convert the meshes.
+    pool.submit([load, decode, upload_meshes, &pool, &uploads, path, format]() {
+        if (!importModel(path, format, load->import, pool)) {
+            load->promise.set_value(nullptr);
+            return;
+        }
+        load->model->directory_ = load->import.directory;
+        load->model->format_ = format;
+        load->model->scene_ = load->import.scene;
+        load->model->instances_ = load->import.instances;
+        load->texture_paths = uniqueTexturePaths(load->import);
+
+        // Stage 2 (GL thread): the TextureCache may only be used there. Cached textures only need a reference.
+        uploads.post([load, decode, upload_meshes]() {
+            Model& model = *load->model;
+            vector<size_t> missing;
+            for (size_t i = 0; i < load->texture_paths.size(); ++i) {
+                string filename = model.directory_ + '/' + load->texture_paths[i];
+                if (TextureCache::instance().contains(filename)) {
+                    model.textures_loaded_[load->texture_paths[i]] = TextureCache::instance().load2D(filename);
+                } else {
+                    missing.push_back(i);
+                }
+            }
+            load->uploads_left = missing.size();
+            if (missing.empty()) {
+                upload_meshes();
+            } else {
+                decode(missing);
+            }
+        });
+    });
+    return result;
+}
+
+// Hashed at compile time, the draws set it once per node.
+static constexpr UniformName MODEL_UNIFORM("model");
+
+void Model::draw(Shader& shader)
+{
+    draw(shader, glm::mat4(1.0f));
+}
+
+void Model::draw(Shader& shader, const glm::mat4& transform)
+{
+    scene_.updateWorld();
+    // Instances are in node order, so the transform only changes between nodes.
+    uint32_t current_node = ~0u;
+    for (const MeshInstance& instance : instances_) {
+        if (instance.node != current_node) {
+            current_node = instance.node;
+            shader.setMat4(shader.uniform(MODEL_UNIFORM), transform * scene_.world(current_node));
+        }
+        meshes_[instance.mesh].draw(shader);
+    }
+}
+
+size_t Model::drawInstanced(Shader& shader, const InstanceBuffer& instances)
+{
+    scene_.updateWorld();
+    size_t triangles = 0;
+    uint32_t current_node = ~0u;
+    for (const MeshInstance& instance : instances_) {
+        if (instance.node != current_node) {
+            current_node = instance.node;
+            shader.setMat4(shader.uniform(MODEL_UNIFORM), scene_.world(current_node));
+        }
+        triangles += meshes_[instance.mesh].drawInstanced(shader, instances);
+    }
+    return triangles;
+}
+
+size_t Model::draw(Shader& shader, const glm::mat4& transform, const Camera& camera, float viewport_height,
+                   float max_pixel_error)
+{
+    scene_.updateWorld();
+    size_t triangles = 0;
+    uint32_t current_node = ~0u;
+    glm::vec3 eye(0.0f);
+    float pixels_per_unit = 0.0f;
+    for (const MeshInstance& instance : instances_) {
+        if (instance.node != current_node) {
+            current_node = instance.node;
+            glm::mat4 node_transform = transform * scene_.world(current_node);
+            shader.setMat4(shader.uniform(MODEL_UNIFORM), node_transform);
+            eye = glm::vec3(glm::inverse(node_transform) * glm::vec4(camera.position_, 1.0f));
+            pixels_per_unit = lodPixelsPerUnit(node_transform, camera, viewport_height);
+        }
+        Mesh& mesh = meshes_[instance.mesh];
+        triangles += mesh.draw(shader, mesh.selectLod(eye, pixels_per_unit, max_pixel_error));
+    }
+    return triangles;
+}
+
+void Model::draw(Shader& shader, const glm::mat4& transform, const Camera& camera, const glm::mat4& projection,
+                 float viewport_height, float max_pixel_error, Culling::Stats& stats)
+{
+    scene_.updateWorld();
+    glm::mat4 view_projection = projection * camera.getViewMatrix();
+    uint32_t current_node = ~0u;
+    Culling::View view;
+    float pixels_per_unit = 0.0f;
+    for (const MeshInstance& instance : instances_) {
+        if (instance.node != current_node) {
+            // Cull in the node's space: the frustum of the full node-to-clip matrix is already expressed in it.
+            current_node = instance.node;
+            glm::mat4 node_transform = transform * scene_.world(current_node);
+            shader.setMat4(shader.uniform(MODEL_UNIFORM), node_transform);
+            view.frustum = Culling::extractFrustum(view_projection * node_transform);
+            view.eye = glm::vec3(glm::inverse(node_transform) * glm::vec4(camera.position_, 1.0f));
+            pixels_per_unit = lodPixelsPerUnit(node_transform, camera, viewport_height);
+        }
+        Mesh& mesh = meshes_[instance.mesh];
+        mesh.draw(shader, mesh.selectLod(view.eye, pixels_per_unit, max_pixel_error), view, stats);
+    }
+}
+
+void Model::draw(ShaderVariants& variants, const ShaderDefines& defines, const glm::mat4& transform,
+                 const std::function<void(Shader&)>& setup)
+{
+    uint64_t key = ShaderSource::hashDefines(defines);
+    if (variant_defines_.empty() || key != variant_defines_key_) {
+        variant_defines_key_ = key;
+        variant_defines_.assign(2, defines);
+        variant_defines_[0]["SPECULAR_MAP"] = "0";
+        variant_defines_[1]["SPECULAR_MAP"] = "1";
+    }
+
+    scene_.updateWorld();
+    // One pass per variant, so each program is made current once per draw.
+    for (size_t specular_map = 0; specular_map < variant_defines_.size(); ++specular_map) {
+        Shader* shader = nullptr;
+        uint32_t current_node = ~0u;
+        for (const MeshInstance& instance : instances_) {
+            Mesh& mesh = meshes_[instance.mesh];
+            if (mesh.hasTexture(TextureRole::SPECULAR) != (specular_map == 1)) {
+                continue;
+            }
+            if (shader == nullptr) {
+                // Variants no mesh needs are never compiled.
+                shader = &variants.get(variant_defines_[specular_map]);
+                shader->use();
+                if (setup) {
+                    setup(*shader);
+                }
+            }
+            if (instance.node != current_node) {
+                current_node = instance.node;
+                shader->setMat4(shader->uniform(MODEL_UNIFORM), transform * scene_.world(current_node));
+            }
+            mesh.draw(*shader);
+        }
+    }
+}
 
-Model::Model(const char* path)
+void Model::submit(RenderQueue& queue, RenderQueue::Item item, const glm::mat4& transform)
 {
-    loadModel(path);
+    scene_.updateWorld();
+    uint32_t current_node = ~0u;
+    for (const MeshInstance& instance : instances_) {
+        if (instance.node != current_node) {
+            current_node = instance.node;
+            item.transform = transform * scene_.world(current_node);
+        }
+        Mesh& mesh = meshes_[instance.mesh];
+        item.mesh = &mesh;
+        item.material = mesh.materialKey();
+        item.depth = queue.depthOf(glm::vec3(item.transform * glm::vec4(mesh.boundsCenter(), 1.0f)));
+        queue.add(item);
+    }
 }
 
-void Model::draw(Shader shader)
+void Model::submit(RenderQueue& queue, RenderQueue::Item item, const glm::mat4& transform,
+                   const Culling::Frustum& frustum, Culling::Stats& stats)
 {
-    for (auto mesh : meshes_) {
-        mesh.draw(shader);
+    scene_.updateWorld();
+    instance_boxes_.clear();
+    uint32_t current_node = ~0u;
+    glm::mat4 node_transform(1.0f);
+    for (const MeshInstance& instance : instances_) {
+        if (instance.node != current_node) {
+            current_node = instance.node;
+            node_transform = transform * scene_.world(current_node);
+        }
+        instance_boxes_.add(meshes_[instance.mesh].boundingBox(), node_transform);
     }
+    size_t visible = Culling::cullBoxes(frustum, instance_boxes_, visible_instances_);
+    stats.objects += instances_.size();
+    stats.objects_culled += instances_.size() - visible;
+
+    current_node = ~0u;
+    for (uint32_t index : visible_instances_) {
+        const MeshInstance& instance = instances_[index];
+        if (instance.node != current_node) {
+            current_node = instance.node;
+            item.transform = transform * scene_.world(current_node);
+        }
+        Mesh& mesh = meshes_[instance.mesh];
+        item.mesh = &mesh;
+        item.material = mesh.materialKey();
+        item.depth = queue.depthOf(glm::vec3(item.transform * glm::vec4(mesh.boundsCenter(), 1.0f)));
+        queue.add(item);
+    }
+}
+
+float Model::lodPixelsPerUnit(const glm::mat4& transform, const Camera& camera, float viewport_height)
+{
+    // Selection runs in model space, where a uniform scale cancels out of error / distance. For non-uniform
+    // scales the ratio of the largest to the smallest axis scale keeps the estimate conservative.
+    glm::vec3 scales(glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])),
+                     glm::length(glm::vec3(transform[2])));
+    float min_scale = std::min(scales.x, std::min(scales.y, scales.z));
+    float max_scale = std::max(scales.x, std::max(scales.y, scales.z));
+    float anisotropy = min_scale > 0.0f ? max_scale / min_scale : 1.0f;
+    return anisotropy * viewport_height / (2.0f * std::tan(glm::radians(camera.zoom_) * 0.5f));
 }
 
-void Model::loadModel(string path)
+bool Model::timeConversion(const string& path, ThreadPool* pool, ConversionTimes& times)
 {
+    auto start = std::chrono::steady_clock::now();
     Assimp::Importer importer;
-    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_FlipUVs);
+    const aiScene* scene = importer.ReadFile(path, IMPORT_FLAGS);
+    if (scene == nullptr || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || scene->mRootNode == nullptr) {
+        cout << "ERROR::ASSIMP::" << importer.GetErrorString() << endl;
+        return false;
+    }
+    auto parsed = std::chrono::steady_clock::now();
+    vector<MeshSource> sources;
+    SceneGraph graph;
+    vector<MeshInstance> instances;
+    convertScene(scene, pool, sources, graph, instances);
+    auto converted = std::chrono::steady_clock::now();
+
+    times.parse_ms = std::chrono::duration<double, std::milli>(parsed - start).count();
+    times.convert_ms = std::chrono::duration<double, std::milli>(converted - parsed).count();
+    times.meshes = sources.size();
+    return true;
+}
+
+bool Model::importModel(const string& path, VertexFormat format, Import& import, ThreadPool& pool)
+{
+    if (!cookMeshes(path, import, pool)) {
+        return false;
+    }
+    // The cache keeps full floats, the compact formats are derived from them on every load.
+    import.bounds.resize(import.meshes.size());
+    import.boxes.resize(import.meshes.size());
+    for (size_t i = 0; i < import.meshes.size(); ++i) {
+        import.boxes[i] = boundingBox(import.meshes[i]);
+        import.bounds[i] = boundingSphere(import.meshes[i], import.boxes[i]);
+    }
+
+    import.format = format;
+    if (format != VertexFormat::FLOAT) {
+        import.quantized.resize(import.meshes.size());
+        import.quantization.resize(import.meshes.size());
+        pool.parallelFor(import.meshes.size(), [&import, format](size_t i) {
+            const MeshCache::CookedMesh& mesh = import.meshes[i];
+            import.quantization[i] =
+                quantizeVertices(mesh.vertices, mesh.vertex_count, format, import.quantized[i]);
+        });
+    }
+    return true;
+}
+
+bool Model::cookMeshes(const string& path, Import& import, ThreadPool& pool)
+{
+    const unsigned int import_flags = IMPORT_FLAGS;
+    import.directory = path.substr(0, path.find_last_of('/'));
+
+    // Warm load: the cooked meshes are still valid for this source file and import flags.
+    MeshCache::Key key;
+    bool has_key = MeshCache::makeKey(path, import_flags, key);
+    string cache_path = MeshCache::cachePath(path);
+    if (has_key && import.cache.open(cache_path, key)) {
+        import.meshes = import.cache.meshes();
+        import.scene = import.cache.scene();
+        import.instances = import.cache.instances();
+        return true;
+    }
+
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, import_flags);
 
     // Error handling.
     if (scene == nullptr || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || scene->mRootNode == nullptr) {
         cout << "ERROR::ASSIMP::" << importer.GetErrorString() << endl;
-        return;
+        return false;
     }
 
-    directory_ = path.substr(0, path.find_last_of('/'));
-    processNode(scene->mRootNode, scene);
+    convertScene(scene, &pool, import.sources, import.scene, import.instances);
+
+    import.meshes.reserve(import.sources.size());
+    for (const MeshSource& source : import.sources) {
+        MeshCache::CookedMesh mesh;
+        mesh.vertices = source.vertices.data();
+        mesh.vertex_count = static_cast<uint32_t>(source.vertices.size());
+        mesh.indices = source.indices.data();
+        mesh.index_count = static_cast<uint32_t>(source.indices.size());
+        mesh.chunks = source.chunks;
+        mesh.lods = source.lods;
+        mesh.meshlets = source.meshlets;
+        mesh.textures = source.textures;
+        mesh.optimization = source.optimization;
+        import.meshes.push_back(mesh);
+    }
+
+    if (has_key && !MeshCache::write(cache_path, key, import.meshes, import.scene, import.instances)) {
+        cout << "ERROR::MESH_CACHE::WRITE_FAILED " << cache_path << endl;
+    }
+    return true;
 }
 
-void Model::processNode(aiNode* node, const aiScene* scene)
+Culling::Box Model::boundingBox(const MeshCache::CookedMesh& mesh)
 {
-    // Process node.
-    for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
-        aiMesh* mesh = scene->mMeshes[node->mMeshes[i]];
-        meshes_.push_back(processMesh(mesh, scene));
+    Culling::Box box;
+    if (mesh.vertex_count == 0) {
+        return box;
+    }
+    glm::vec3 min_position = mesh.vertices[0].position;
+    glm::vec3 max_position = min_position;
+    for (uint32_t i = 1; i < mesh.vertex_count; ++i) {
+        min_position = glm::min(min_position, mesh.vertices[i].position);
+        max_position = glm::max(max_position, mesh.vertices[i].position);
     }
+    box.center = (min_position + max_position) * 0.5f;
+    box.extent = (max_position - min_position) * 0.5f;
+    return box;
+}
 
-    // Traverse children.
-    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
-        processNode(node->mChildren[i], scene);
+glm::vec4 Model::boundingSphere(const MeshCache::CookedMesh& mesh, const Culling::Box& box)
+{
+    // Around the box center, tighter than the box's own circumsphere.
+    float radius = 0.0f;
+    for (uint32_t i = 0; i < mesh.vertex_count; ++i) {
+        radius = std::max(radius, glm::length(mesh.vertices[i].position - box.center));
     }
+    return glm::vec4(box.center, radius);
 }
 
-Mesh Model::processMesh(aiMesh* mesh, const aiScene* scene)
+void Model::convertScene(const aiScene* scene, ThreadPool* pool, vector<MeshSource>& sources, SceneGraph& graph,
+                         vector<MeshInstance>& instances)
 {
-    vector<Vertex> vertices;
-    vector<unsigned int> indices;
-    vector<Texture> textures;
+    // Flatten the node tree first and gather the meshes it references. Each mesh is converted once however many
+    // nodes use it, and independently of the others.
+    vector<const aiMesh*> meshes;
+    vector<uint32_t> mesh_slots(scene->mNumMeshes, ~0u);
+    graph.clear();
+    instances.clear();
+    flattenNode(scene->mRootNode, SceneGraph::NO_PARENT, scene, graph, instances, meshes, mesh_slots);
+
+    sources.clear();
+    sources.resize(meshes.size());
+    auto convert = [&meshes, &sources, scene](size_t i) { sources[i] = processMesh(meshes[i], scene); };
+    if (pool != nullptr) {
+        pool->parallelFor(meshes.size(), convert);
+    } else {
+        for (size_t i = 0; i < meshes.size(); ++i) {
+            convert(i);
+        }
+    }
+}
 
-    // Process vertices.
-    for (unsigned int i = 0; i < mesh->mNumVertices; ++i) {
-        Vertex vertex;
-        vertex.position.x = mesh->mVertices[i].x;
-        vertex.position.y = mesh->mVertices[i].y;
-        vertex.position.z = mesh->mVertices[i].z;
+void Model::flattenNode(const aiNode* node, int32_t parent, const aiScene* scene, SceneGraph& graph,
+                        vector<MeshInstance>& instances, vector<const aiMesh*>& meshes, vector<uint32_t>& mesh_slots)
+{
+    // Assimp matrices are row-major.
+    glm::mat4 local = glm::transpose(glm::make_mat4(&node->mTransformation.a1));
+    uint32_t id = graph.addNode(parent, local);
+    for (unsigned int i = 0; i < node->mNumMeshes; ++i) {
+        unsigned int scene_mesh = node->mMeshes[i];
+        if (mesh_slots[scene_mesh] == ~0u) {
+            mesh_slots[scene_mesh] = static_cast<uint32_t>(meshes.size());
+            meshes.push_back(scene->mMeshes[scene_mesh]);
+        }
+        MeshInstance instance;
+        instance.node = id;
+        instance.mesh = mesh_slots[scene_mesh];
+        instances.push_back(instance);
+    }
+    for (unsigned int i = 0; i < node->mNumChildren; ++i) {
+        flattenNode(node->mChildren[i], static_cast<int32_t>(id), scene, graph, instances, meshes, mesh_slots);
+    }
+}
 
-        vertex.normal.x = mesh->mNormals[i].x;
-        vertex.normal.y = mesh->mNormals[i].y;
-        vertex.normal.z = mesh->mNormals[i].z;
+namespace {
+    static_assert(sizeof(aiVector3D) == 3 * sizeof(float), "Assimp built with double precision");
 
-        if (mesh->mTextureCoords[0]) {
-            vertex.tex_coords.x = mesh->mTextureCoords[0][i].x;
-            vertex.tex_coords.y = mesh->mTextureCoords[0][i].y;
-        } else {
-            vertex.tex_coords = glm::vec2(0.0f, 0.0f);
+    // Copies the first Components floats of each packed aiVector3D into the same field of every vertex. Fixed
+    // strides on both sides and no branches, so the compiler can unroll and vectorize the loop.
+    template <size_t Components>
+    void copyToVertices(const aiVector3D* source, size_t count, size_t field_offset, Vertex* vertices)
+    {
+        const float* from = reinterpret_cast<const float*>(source);
+        float* to = reinterpret_cast<float*>(reinterpret_cast<unsigned char*>(vertices) + field_offset);
+        const size_t to_stride = sizeof(Vertex) / sizeof(float);
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t c = 0; c < Components; ++c) {
+                to[i * to_stride + c] = from[i * 3 + c];
+            }
         }
-        vertices.push_back(vertex);
     }
+}  // namespace
 
-    // Process indices.
+Model::MeshSource Model::processMesh(const aiMesh* mesh, const aiScene* scene)
+{
+    MeshSource source;
+    vector<Vertex>& vertices = source.vertices;
+    vector<unsigned int> indices;
+
+    // Process vertices, one attribute at a time into the preallocated array. Missing attributes stay zero.
+    vertices.assign(mesh->mNumVertices, Vertex{glm::vec3(0.0f), glm::vec3(0.0f), glm::vec2(0.0f)});
+    copyToVertices<3>(mesh->mVertices, vertices.size(), offsetof(Vertex, position), vertices.data());
+    if (mesh->mNormals != nullptr) {
+        copyToVertices<3>(mesh->mNormals, vertices.size(), offsetof(Vertex, normal), vertices.data());
+    }
+    if (mesh->mTextureCoords[0] != nullptr) {
+        copyToVertices<2>(mesh->mTextureCoords[0], vertices.size(), offsetof(Vertex, tex_coords), vertices.data());
+    }
+
+    // Process indices. Meshes are drawn as triangle lists, so the points and lines Triangulate leaves are skipped.
+    size_t triangle_count = 0;
+    for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
+        triangle_count += mesh->mFaces[i].mNumIndices == 3 ? 1 : 0;
+    }
+    indices.resize(triangle_count * 3);
+    unsigned int* index = indices.data();
     for (unsigned int i = 0; i < mesh->mNumFaces; ++i) {
-        aiFace face = mesh->mFaces[i];
-        for (unsigned int j = 0; j < face.mNumIndices; ++j) {
-            indices.push_back(face.mIndices[j]);
+        const aiFace& face = mesh->mFaces[i];
+        if (face.mNumIndices == 3) {
+            index[0] = face.mIndices[0];
+            index[1] = face.mIndices[1];
+            index[2] = face.mIndices[2];
+            index += 3;
+        }
+    }
+
+    // Weld, reorder and cut into 16-bit chunks, the cache stores the result so this only runs on cold loads.
+    source.optimization = MeshOptimizer::optimize(vertices, indices);
+    vector<vector<unsigned int>> lods;
+    vector<float> lod_errors;
+    if (vertices.size() <= IndexBuffer::MAX_CHUNK_VERTICES) {
+        MeshSimplifier::buildLodChain(vertices, indices, lods, lod_errors);
+    }
+    IndexBuffer::split(vertices, indices, source.indices, source.chunks);
+
+    // The simplified levels index the same vertices and follow the full mesh in the index range. Meshes split over
+    // several chunks keep their full detail only.
+    if (!lods.empty()) {
+        IndexBuffer::Lod full;
+        full.chunk_count = static_cast<uint32_t>(source.chunks.size());
+        source.lods.push_back(full);
+        for (size_t i = 0; i < lods.size(); ++i) {
+            IndexBuffer::appendLod(lods[i], lod_errors[i], source.indices, source.chunks, source.lods);
         }
     }
+    Meshlets::build(vertices, source.indices, source.chunks, source.meshlets);
 
-    // Process textures.
+    // Process textures, they are loaded later together with the other meshes' ones.
     if (mesh->mMaterialIndex >= 0) {
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
-        vector<Texture> diffuse_maps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "texture_diffuse");
-        textures.insert(textures.end(), diffuse_maps.begin(), diffuse_maps.end());
-
-        vector<Texture> specular_maps = loadMaterialTextures(material, aiTextureType_SPECULAR, "texture_specular");
-        textures.insert(textures.end(), specular_maps.begin(), specular_maps.end());
+        collectMaterialTextures(material, aiTextureType_DIFFUSE, TextureRole::DIFFUSE, source.textures);
+        collectMaterialTextures(material, aiTextureType_SPECULAR, TextureRole::SPECULAR, source.textures);
+        collectMaterialTextures(material, aiTextureType_NORMALS, TextureRole::NORMAL, source.textures);
     }
 
-    return Mesh(vertices, indices, textures);
+    return source;
 }
 
-vector<Texture> Model::loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string type_name)
+void Model::collectMaterialTextures(aiMaterial* mat, aiTextureType type, TextureRole role,
+                                    vector<MeshCache::TextureRef>& textures)
 {
-    vector<Texture> textures;
     for (unsigned int i = 0; i < mat->GetTextureCount(type); ++i) {
         aiString str;
         mat->GetTexture(type, i, &str);
-        bool skip = false;
-        for (auto texture_loaded : textures_loaded_) {
-            if (std::strcmp(texture_loaded.path.C_Str(), str.C_Str()) == 0) {
-                textures.push_back(texture_loaded);
-                skip = true;
-                break;
+        textures.push_back({role, str.C_Str()});
+    }
+}
+
+vector<string> Model::uniqueTexturePaths(const Import& import)
+{
+    vector<string> paths;
+    std::unordered_set<string> seen;
+    for (const MeshCache::CookedMesh& mesh : import.meshes) {
+        for (const MeshCache::TextureRef& ref : mesh.textures) {
+            if (seen.insert(ref.path).second) {
+                paths.push_back(ref.path);
             }
         }
-        if (!skip) {
-            Texture texture;
-            texture.id = textureFromFile(str.C_Str(), directory_);
-            texture.type = type_name;
-            texture.path = str;
-            textures.push_back(texture);
-        }
     }
-    return textures;
+    return paths;
+}
+
+void Model::loadMaterialTextures(const Import& import, ThreadPool& pool)
+{
+    // Load the textures of all meshes at once so the decodes spread over the pool. Textures other models already
+    // loaded are shared, the rest is decoded on the workers and uploaded here.
+    vector<string> paths = uniqueTexturePaths(import);
+    vector<string> filenames;
+    for (const string& path : paths) {
+        filenames.push_back(directory_ + '/' + path);
+    }
+
+    vector<unsigned int> ids = TextureCache::instance().load2D(filenames, pool);
+    for (size_t i = 0; i < paths.size(); ++i) {
+        textures_loaded_[paths[i]] = ids[i];
+    }
 }
 
-// Static.
-unsigned int textureFromFile(const char* path, const string& directory, bool gamma)
-{
-    string filename = string(path);
-    filename = directory + '/' + filename;
-
-    unsigned int texture;
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-    // Flip vertically.
-    stbi_set_flip_vertically_on_load(true);
-
-    // Load texture.
-    int width = 0;
-    int height = 0;
-    int nrChannels = 0;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrChannels, 0);
-    if (data != nullptr) {
-        GLenum rgb_mode;
-        if (nrChannels == 1) {
-            rgb_mode = GL_RED;
-        } else if (nrChannels == 3) {
-            rgb_mode = GL_RGB;
-        } else if (nrChannels == 4) {
-            rgb_mode = GL_RGBA;
-        }
-        glTexImage2D(GL_TEXTURE_2D, 0, rgb_mode, width, height, 0, rgb_mode, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+void Model::createMeshes(const Import& import)
+{
+    meshes_.reserve(import.meshes.size());
+    for (size_t i = 0; i < import.meshes.size(); ++i) {
+        createMesh(import, i);
+    }
+}
+
+void Model::createMesh(const Import& import, size_t index)
+{
+    const MeshCache::CookedMesh& mesh = import.meshes[index];
+    if (import.format == VertexFormat::FLOAT) {
+        meshes_.push_back(
+            Mesh(mesh.vertices, mesh.vertex_count, mesh.indices, mesh.index_count, mesh.chunks, mesh.lods,
+                 resolveTextures(mesh.textures)));
     } else {
-        std::cout << "Failed to load texture." << std::endl;
+        meshes_.push_back(Mesh(import.quantized[index], import.format, mesh.indices, mesh.index_count, mesh.chunks,
+                               mesh.lods, resolveTextures(mesh.textures)));
+        quantization_.push_back(import.quantization[index]);
     }
-    // Recycle the image data.
-    stbi_image_free(data);
-    return texture;
-}
\ No newline at end of file
+    const glm::vec4& bounds = import.bounds[index];
+    meshes_.back().setBoundingSphere(glm::vec3(bounds), bounds.w);
+    meshes_.back().setBoundingBox(import.boxes[index]);
+    meshes_.back().setMeshlets(mesh.meshlets);
+    optimization_.push_back(mesh.optimization);
+}
+
+vector<Texture> Model::resolveTextures(const vector<MeshCache::TextureRef>& refs) const
+{
+    vector<Texture> textures;
+    textures.reserve(refs.size());
+    for (const MeshCache::TextureRef& ref : refs) {
+        Texture texture;
+        texture.id = textures_loaded_.at(ref.path);
+        texture.path = StringTable::shared().intern(ref.path);
+        texture.role = ref.role;
+        textures.push_back(texture);
+    }
+    return textures;
+}
@@ -2,27 +2,163 @@
 #ifndef MODEL_H
 #define MODEL_H
 
+#include <functional>
+#include <future>
+#include <memory>
+#include <unordered_map>
 #include <vector>
 #include <string>
 
 #include "assimp/scene.h"
 
+#include "camera.h"
 #include "shader.h"
+#include "shader_variants.h"
 #include "mesh.h"
+#include "mesh_cache.h"
+#include "mesh_optimizer.h"
+#include "render_queue.h"
+#include "scene_graph.h"
+#include "thread_pool.h"
+#include "upload_queue.h"
 
 class Model {
 public:
-    Model(const char* path);
-    void draw(Shader shader);
+    // Assimp post-processing steps, part of the mesh cache key.
+    static const unsigned int IMPORT_FLAGS;
+
+    // Mesh conversion and texture decoding run on the pool, with the calling (GL) thread helping with the
+    // conversion. Everything else runs on the calling thread.
+    Model(const char* path, ThreadPool& pool = ThreadPool::shared(), VertexFormat format = VertexFormat::FLOAT);
+    // Parsing, mesh conversion and texture decoding run on the pool, only the GL object creation is posted to
+    // `uploads`, one task per texture and per mesh labelled with its file name so the queue can budget and report
+    // them. The future is fulfilled from UploadQueue::process(), so the render loop has to keep draining it.
+    // Yields nullptr if the file can't be imported.
+    static std::future<std::unique_ptr<Model>> loadAsync(const std::string& path,
+                                                         ThreadPool& pool = ThreadPool::shared(),
+                                                         UploadQueue& uploads = UploadQueue::main(),
+                                                         VertexFormat format = VertexFormat::FLOAT);
+    // Drops the model's references in the TextureCache, the meshes return their geometry to the arena.
+    ~Model();
+    Model(Model&& other) noexcept;
+    Model& operator=(Model&& other) noexcept;
+    Model(const Model&) = delete;
+    Model& operator=(const Model&) = delete;
+
+    // Draws every mesh instance with the world transform of its node, on top of `transform`. Sets the shader's
+    // "model" matrix.
+    void draw(Shader& shader);
+    void draw(Shader& shader, const glm::mat4& transform);
+    // Draws each mesh instance at the coarsest level of detail whose simplification error projects to at most
+    // `max_pixel_error` pixels for `camera`. `transform` is the model matrix the shader uses, `viewport_height` is
+    // in pixels. Returns the number of triangles drawn.
+    size_t draw(Shader& shader, const glm::mat4& transform, const Camera& camera, float viewport_height,
+                float max_pixel_error = 1.0f);
+    // As above, and skips the meshlets outside the frustum of `projection` or facing away from the camera.
+    // Accumulates into `stats` what was culled and drawn.
+    void draw(Shader& shader, const glm::mat4& transform, const Camera& camera, const glm::mat4& projection,
+              float viewport_height, float max_pixel_error, Culling::Stats& stats);
+    // Draws every mesh instance once per transform in `instances`, one draw call per mesh chunk however many
+    // transforms there are. The shader's INSTANCED permutation applies each transform on top of the node's world
+    // transform, which goes to "model". Returns the number of triangles drawn.
+    size_t drawInstanced(Shader& shader, const InstanceBuffer& instances);
+    // Adds one item per mesh instance to `queue`, based on `item` (layer, transparency, pipeline, shader) with the
+    // mesh, its material, the world transform on top of `transform` and the depth of its bounds filled in.
+    void submit(RenderQueue& queue, RenderQueue::Item item, const glm::mat4& transform);
+    // As above, and leaves out the mesh instances whose world space box is outside `frustum` (see
+    // Camera::getFrustum). All of them are tested in one batch, see Culling::cullBoxes. Counts them into
+    // `stats.objects` and `stats.objects_culled`.
+    void submit(RenderQueue& queue, RenderQueue::Item item, const glm::mat4& transform,
+                const Culling::Frustum& frustum, Culling::Stats& stats);
+    // Draws every mesh with the cheapest variant of `variants` it can use: `defines` plus SPECULAR_MAP 1 for the
+    // meshes with a specular map and 0 for the rest. `setup` runs each time a variant is made current, for the
+    // per-frame uniforms.
+    void draw(ShaderVariants& variants, const ShaderDefines& defines, const glm::mat4& transform,
+              const std::function<void(Shader&)>& setup);
+    // Per mesh, from the import that produced the cooked geometry.
+    const std::vector<MeshOptimizer::Report>& optimizationReports() const { return optimization_; }
+    // Per mesh, empty for VertexFormat::FLOAT.
+    const std::vector<QuantizationError>& quantizationReports() const { return quantization_; }
+    VertexFormat vertexFormat() const { return format_; }
+    // Node hierarchy from the file. Changed local transforms are picked up by the next draw.
+    SceneGraph& scene() { return scene_; }
+    const std::vector<MeshInstance>& instances() const { return instances_; }
+
+    struct ConversionTimes {
+        double parse_ms = 0.0;
+        double convert_ms = 0.0;
+        size_t meshes = 0;
+    };
+    // Runs the CPU side of a cold import (Assimp, then the mesh conversion with optimization, LODs and meshlets)
+    // without the cache or any GL work, for measuring. A null `pool` converts the meshes on the calling thread.
+    static bool timeConversion(const std::string& path, ThreadPool* pool, ConversionTimes& times);
 private:
-    void loadModel(std::string path);
-    void processNode(aiNode* node, const aiScene* scene);
-    Mesh processMesh(aiMesh* mesh, const aiScene* scene);
-    std::vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, std::string typeName);
+    // A converted mesh whose textures haven't been loaded yet.
+    struct MeshSource {
+        std::vector<Vertex> vertices;
+        std::vector<uint16_t> indices;
+        std::vector<IndexBuffer::Chunk> chunks;
+        std::vector<IndexBuffer::Lod> lods;
+        std::vector<Meshlets::Meshlet> meshlets;
+        std::vector<MeshCache::TextureRef> textures;
+        MeshOptimizer::Report optimization;
+    };
+
+    // CPU side of a load, safe to produce off the GL thread.
+    struct Import {
+        std::string directory;
+        MeshCache::Reader cache;                    // Warm load: the mapped cache file.
+        std::vector<MeshSource> sources;            // Cold load: meshes converted from Assimp.
+        std::vector<MeshCache::CookedMesh> meshes;  // Views into one of the two above.
+        VertexFormat format = VertexFormat::FLOAT;
+        std::vector<QuantizedVertices> quantized;   // Per mesh, compact formats only.
+        std::vector<QuantizationError> quantization;
+        std::vector<glm::vec4> bounds;              // Per mesh bounding sphere, center and radius.
+        std::vector<Culling::Box> boxes;            // Per mesh bounding box.
+        SceneGraph scene;
+        std::vector<MeshInstance> instances;
+    };
+    struct AsyncLoad;
+
+    Model() = default;
+    void releaseTextures();
+    // Mesh conversion and quantization run on `pool` and the calling thread.
+    static bool importModel(const std::string& path, VertexFormat format, Import& import, ThreadPool& pool);
+    static bool cookMeshes(const std::string& path, Import& import, ThreadPool& pool);
+    static void convertScene(const aiScene* scene, ThreadPool* pool, std::vector<MeshSource>& sources,
+                             SceneGraph& graph, std::vector<MeshInstance>& instances);
+    static void flattenNode(const aiNode* node, int32_t parent, const aiScene* scene, SceneGraph& graph,
+                            std::vector<MeshInstance>& instances, std::vector<const aiMesh*>& meshes,
+                            std::vector<uint32_t>& mesh_slots);
+    static MeshSource processMesh(const aiMesh* mesh, const aiScene* scene);
+    static Culling::Box boundingBox(const MeshCache::CookedMesh& mesh);
+    static glm::vec4 boundingSphere(const MeshCache::CookedMesh& mesh, const Culling::Box& box);
+    // Pixels covered by one model unit at distance 1, for Mesh::selectLod.
+    static float lodPixelsPerUnit(const glm::mat4& transform, const Camera& camera, float viewport_height);
+    static void collectMaterialTextures(aiMaterial* mat, aiTextureType type, TextureRole role,
+                                        std::vector<MeshCache::TextureRef>& textures);
+    static std::vector<std::string> uniqueTexturePaths(const Import& import);
+
+    void loadMaterialTextures(const Import& import, ThreadPool& pool);
+    void createMeshes(const Import& import);
+    void createMesh(const Import& import, size_t index);
+    std::vector<Texture> resolveTextures(const std::vector<MeshCache::TextureRef>& refs) const;
 
     std::vector<Mesh> meshes_;
+    SceneGraph scene_;
+    std::vector<MeshInstance> instances_;  // In node order.
+    std::vector<MeshOptimizer::Report> optimization_;
+    std::vector<QuantizationError> quantization_;
+    VertexFormat format_ = VertexFormat::FLOAT;
     std::string directory_;
-    std::vector<Texture> textures_loaded_;
+    // Texture ids by the path stored in the material, each one holds a TextureCache reference.
+    std::unordered_map<std::string, unsigned int> textures_loaded_;
+    // The caller's defines with SPECULAR_MAP 0 and 1, rebuilt only when their hash changes.
+    uint64_t variant_defines_key_ = 0;
+    std::vector<ShaderDefines> variant_defines_;
+    // World space boxes of the instances and the visible ones, reused by every culled submit.
+    Culling::Boxes instance_boxes_;
+    std::vector<uint32_t> visible_instances_;
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -2,8 +2,7 @@
 layout (location = 0) in vec3 iPosition;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "../common/frame_data.glsl"
 
 void main()
 {
@@ -6,11 +6,13 @@ layout (location = 2) in vec2 aTexCoords;
 out vec2 TexCoords;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "../common/frame_data.glsl"
+// Vertex format decoding, see vertex_format.h.
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
 
 void main()
 {
     TexCoords = aTexCoords;    
-    gl_Position = projection * view * model * vec4(aPos, 1.0);
+    gl_Position = projection * view * model * vec4(positionOffset + aPos * positionScale, 1.0);
 }
\ No newline at end of file
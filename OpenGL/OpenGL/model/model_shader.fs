@@ -5,115 +5,12 @@ in vec2 TexCoords;
 
 out vec4 FragColor;
 
-struct Material {
-	sampler2D diffuse;
-	sampler2D specular;
-	sampler2D emission;
-	float shininess;
-};
-
-struct DirLight {
-	vec3 direction;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-};
-
-struct PointLight {
-	vec3 position;
-
-	vec3 ambient;
-	vec3 diffuse;
-	vec3 specular;
-
-	float constant;
-	float linear;
-	float quadratic;
-};
-
-struct SpotLight {
-	PointLight basic;
-
-	vec3 direction;
-	// ǶȵֵǽǶȣԺܶͱȽ϶Ƕ෴
-	float cutOff;
-	float outerCutOff;
-};
-
-#define NR_POINT_LIGHTS 4
-
-uniform Material material;
-uniform DirLight dirLight;
-uniform PointLight pointLights[NR_POINT_LIGHTS];
-uniform SpotLight spotLight;
-
-uniform vec3 viewPos;
-
-vec3 calcDirLight(DirLight light, vec3 normal, vec3 viewDir)
-{
-	vec3 lightDir = normalize(-light.direction);
-	float diff = max(dot(normal, lightDir), 0.0);
-
-	vec3 reflectDir = reflect(-lightDir, normal);
-	float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-
-	vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-	vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-	return (ambient + diffuse + specular);
-}
-
-vec3 calcPointLight(PointLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-	vec3 lightDir = normalize(light.position - FragPos);
-
-	float diff = max(dot(normal, lightDir), 0.0);
-	
-	vec3 reflectDir = reflect(-lightDir, normal);
-	float spec = pow(max(dot(reflectDir, viewDir), 0.0), material.shininess);
-
-	float distance = length(light.position - FragPos);
-	float attenuation = 1.0 / (light.constant + light.linear * distance + light.quadratic * (distance * distance));
-
-	vec3 ambient = light.ambient * vec3(texture(material.diffuse, TexCoords));
-	vec3 diffuse = light.diffuse * diff * vec3(texture(material.diffuse, TexCoords));
-	vec3 specular = light.specular * spec * vec3(texture(material.specular, TexCoords));
-
-	ambient *= attenuation;
-	diffuse *= attenuation;
-	specular *= attenuation;
-
-	return (ambient + diffuse + specular);
-}
-
-vec3 calcSpotLight(SpotLight light, vec3 normal, vec3 fragPos, vec3 viewDir)
-{
-	vec3 lightDir = normalize(light.basic.position - fragPos);
-	float theta = dot(lightDir, normalize(-light.direction));
-	// Ҳֵ
-	float epsilon = light.cutOff - light.outerCutOff;
-	float intensity = clamp((theta - light.outerCutOff) / epsilon, 0.0, 1.0);
-
-	vec3 result = calcPointLight(light.basic, normal, fragPos, viewDir);
-	// رԵ
-	return result * intensity;
-}
+#include "../common/lights.glsl"
 
 void main()
 {
-	vec3 normal = normalize(Normal);
-	vec3 viewDir = normalize(viewPos - FragPos);
-
-	// Direction light.
-	vec3 result = calcDirLight(dirLight, normal, viewDir);
-	// Point lights.
-	for (int i = 0; i < NR_POINT_LIGHTS; i++) {
-		result += calcPointLight(pointLights[i], normal, FragPos, viewDir);
-	}
-	// Spot light.
-	result += calcSpotLight(spotLight, normal, FragPos, viewDir);
+	vec3 result = calcLighting(normalize(Normal), FragPos, TexCoords);
 
 	// result += emission;
 	FragColor = vec4(result, 1.0);
-}
\ No newline at end of file
+}
@@ -7,15 +7,29 @@ out vec3 Normal;
 out vec3 FragPos;
 out vec2 TexCoords;
 
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+#include "../common/frame_data.glsl"
+#include "../common/instancing.glsl"
+// Vertex format decoding, see vertex_format.h.
+uniform vec3 positionOffset;
+uniform vec3 positionScale;
+uniform bool octahedralNormals;
+
+vec3 octahedralDecode(vec2 e)
+{
+	vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+	if (n.z < 0.0) {
+		n.xy = (1.0 - abs(n.yx)) * vec2(n.x >= 0.0 ? 1.0 : -1.0, n.y >= 0.0 ? 1.0 : -1.0);
+	}
+	return normalize(n);
+}
 
 void main()
 {
-	FragPos = vec3(model * vec4(iPos, 1.0));
+	mat4 transform = modelMatrix();
+	vec3 normal = octahedralNormals ? octahedralDecode(iNormal.xy) : iNormal;
+	FragPos = vec3(transform * vec4(positionOffset + iPos * positionScale, 1.0));
 	// ȱŶԷӰ
-	Normal = mat3(transpose(inverse(model))) * iNormal;
+	Normal = mat3(transpose(inverse(transform))) * normal;
 	TexCoords = iTexCoords;
 	gl_Position = projection * view * vec4(FragPos, 1.0);
 }
\ No newline at end of file
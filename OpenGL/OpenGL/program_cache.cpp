@@ -0,0 +1,215 @@
+#include "program_cache.h"
+
+#include <GLFW/glfw3.h>
+
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+#include "hash.h"
+
+// ARB_get_program_binary, core in 4.1 and therefore missing from the 3.3 loader.
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+namespace ProgramCache {
+    namespace {
+        const uint32_t MAGIC = 0x4e494250;  // "PBIN"
+
+        struct FileHeader {
+            uint32_t magic;
+            uint32_t version;
+            uint64_t key;
+            uint32_t format;
+            uint32_t length;
+        };
+
+        typedef void(APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei buffer_size, GLsizei* length,
+                                                     GLenum* format, void* binary);
+        typedef void(APIENTRYP ProgramBinaryProc)(GLuint program, GLenum format, const void* binary, GLsizei length);
+        typedef void(APIENTRYP ProgramParameteriProc)(GLuint program, GLenum name, GLint value);
+
+        struct Functions {
+            GetProgramBinaryProc get_program_binary = nullptr;
+            ProgramBinaryProc program_binary = nullptr;
+            ProgramParameteriProc program_parameteri = nullptr;
+            bool supported = false;
+        };
+
+        // Resolved on first use, the context has to be current by then.
+        const Functions& functions()
+        {
+            static Functions functions = []() {
+                Functions result;
+                result.get_program_binary = (GetProgramBinaryProc)glfwGetProcAddress("glGetProgramBinary");
+                result.program_binary = (ProgramBinaryProc)glfwGetProcAddress("glProgramBinary");
+                result.program_parameteri = (ProgramParameteriProc)glfwGetProcAddress("glProgramParameteri");
+                GLint formats = 0;
+                if (result.get_program_binary && result.program_binary && result.program_parameteri) {
+                    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+                }
+                result.supported = formats > 0;
+                return result;
+            }();
+            return functions;
+        }
+
+        std::string cache_directory = "shader_cache";
+        Stats cache_stats;
+
+        std::string entryPath(uint64_t key)
+        {
+            char name[32];
+            snprintf(name, sizeof(name), "%016llx.progbin", static_cast<unsigned long long>(key));
+            return cache_directory + '/' + name;
+        }
+
+        std::string glString(GLenum name)
+        {
+            const GLubyte* value = glGetString(name);
+            return value != nullptr ? reinterpret_cast<const char*>(value) : "";
+        }
+    }  // namespace
+
+    void setDirectory(const std::string& directory)
+    {
+        cache_directory = directory;
+    }
+
+    const std::string& directory()
+    {
+        return cache_directory;
+    }
+
+    bool supported()
+    {
+        return functions().supported;
+    }
+
+    uint64_t makeKey(const std::string& vertex_source, const std::string& fragment_source,
+                     const std::string& defines)
+    {
+        // Lengths separate the parts, so moving text from one source into the next changes the key.
+        uint64_t hash = FNV_OFFSET_BASIS;
+        for (const std::string& part : {vertex_source, fragment_source, defines, glString(GL_VENDOR),
+                                        glString(GL_RENDERER), glString(GL_VERSION)}) {
+            uint64_t length = part.size();
+            hash = fnv1a(&length, sizeof(length), hash);
+            hash = fnv1a(part.data(), part.size(), hash);
+        }
+        return hash;
+    }
+
+    bool load(GLuint program, uint64_t key)
+    {
+        if (!supported()) {
+            ++cache_stats.misses;
+            return false;
+        }
+        std::string path = entryPath(key);
+        std::ifstream in(path, std::ios::binary);
+        if (!in) {
+            ++cache_stats.misses;
+            return false;
+        }
+
+        FileHeader header = {};
+        std::vector<char> binary;
+        bool valid = static_cast<bool>(in.read(reinterpret_cast<char*>(&header), sizeof(header))) &&
+                     header.magic == MAGIC && header.version == VERSION && header.key == key && header.length > 0;
+        if (valid) {
+            binary.resize(header.length);
+            valid = static_cast<bool>(in.read(binary.data(), binary.size())) && in.peek() == EOF;
+        }
+        in.close();
+
+        GLint linked = GL_FALSE;
+        if (valid) {
+            functions().program_binary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+            glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        }
+        if (linked != GL_TRUE) {
+            // Corrupt, truncated or refused by the driver: drop it, the caller compiles from source.
+            ++cache_stats.rejected;
+            std::error_code error;
+            std::filesystem::remove(path, error);
+            return false;
+        }
+        ++cache_stats.hits;
+        return true;
+    }
+
+    void prepare(GLuint program)
+    {
+        if (supported()) {
+            functions().program_parameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+    }
+
+    bool store(GLuint program, uint64_t key)
+    {
+        if (!supported()) {
+            return false;
+        }
+        GLint length = 0;
+        glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0) {
+            return false;
+        }
+        std::vector<char> binary(length);
+        GLsizei written = 0;
+        GLenum format = 0;
+        functions().get_program_binary(program, length, &written, &format, binary.data());
+        if (written <= 0) {
+            return false;
+        }
+
+        std::error_code error;
+        std::filesystem::create_directories(cache_directory, error);
+        // Written under a temporary name and renamed, so a crash never leaves a truncated entry behind.
+        std::string path = entryPath(key);
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                std::cout << "ERROR::PROGRAM_CACHE::WRITE_FAILED " << temporary << std::endl;
+                return false;
+            }
+            FileHeader header = {MAGIC, VERSION, key, format, static_cast<uint32_t>(written)};
+            out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            out.write(binary.data(), written);
+            if (!out) {
+                return false;
+            }
+        }
+        std::filesystem::rename(temporary, path, error);
+        return !error;
+    }
+
+    void clear()
+    {
+        std::error_code error;
+        for (auto it = std::filesystem::directory_iterator(cache_directory, error);
+             !error && it != std::filesystem::directory_iterator(); it.increment(error)) {
+            if (it->path().extension() == ".progbin") {
+                std::error_code remove_error;
+                std::filesystem::remove(it->path(), remove_error);
+            }
+        }
+        cache_stats = Stats();
+    }
+
+    const Stats& stats()
+    {
+        return cache_stats;
+    }
+}  // namespace ProgramCache
@@ -0,0 +1,43 @@
+#pragma once
+#ifndef PROGRAM_CACHE_H
+#define PROGRAM_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include <glad/glad.h>
+
+// On-disk cache of linked program binaries (glGetProgramBinary / glProgramBinary).
+// One "<key>.progbin" file per program in the cache directory. The key hashes the sources, the defines and the
+// driver's vendor, renderer and version strings, so a driver update or an edited shader simply misses.
+// Needs GL 4.1 or ARB_get_program_binary; without them, or with no binary format, every lookup misses.
+namespace ProgramCache {
+    // Bump whenever the file layout changes.
+    const uint32_t VERSION = 1;
+
+    struct Stats {
+        size_t hits = 0;
+        size_t misses = 0;
+        size_t rejected = 0;  // Present but corrupt or refused by the driver.
+    };
+
+    // Defaults to "shader_cache" in the working directory.
+    void setDirectory(const std::string& directory);
+    const std::string& directory();
+    bool supported();
+
+    uint64_t makeKey(const std::string& vertex_source, const std::string& fragment_source,
+                     const std::string& defines);
+    // Loads the binary stored for `key` into `program` and checks that it links. Bad entries are deleted.
+    bool load(GLuint program, uint64_t key);
+    // Call before linking a program that is going to be stored.
+    void prepare(GLuint program);
+    // Stores the binary of a linked program.
+    bool store(GLuint program, uint64_t key);
+    // Deletes every cached binary.
+    void clear();
+    const Stats& stats();
+}  // namespace ProgramCache
+
+#endif
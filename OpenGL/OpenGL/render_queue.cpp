@@ -0,0 +1,133 @@
+#include "render_queue.h"
+
+#include <cstring>
+
+#include "mesh.h"
+
+namespace {
+    // Bit positions of the fields, see the layout in render_queue.h.
+    const int LAYER_SHIFT = 60;
+    const int TRANSPARENT_SHIFT = 59;
+    const int OPAQUE_PROGRAM_SHIFT = 47;
+    const int OPAQUE_MATERIAL_SHIFT = 31;
+    const int OPAQUE_DEPTH_SHIFT = 7;
+    const int TRANSPARENT_DEPTH_SHIFT = 35;
+    const int TRANSPARENT_PROGRAM_SHIFT = 23;
+    const int TRANSPARENT_MATERIAL_SHIFT = 7;
+    const uint64_t PROGRAM_MASK = 0xFFF;
+    const uint64_t DEPTH_MASK = 0xFFFFFF;
+
+    // The bit pattern of a non-negative float orders like the float, its top 24 bits keep sign, exponent and the
+    // upper mantissa.
+    uint64_t depthBits(float depth)
+    {
+        if (!(depth > 0.0f)) {
+            return 0;
+        }
+        uint32_t bits;
+        std::memcpy(&bits, &depth, sizeof(bits));
+        return bits >> 8;
+    }
+}  // namespace
+
+void RenderQueue::begin(const glm::vec3& eye)
+{
+    eye_ = eye;
+    items_.clear();
+}
+
+float RenderQueue::depthOf(const glm::vec3& position) const
+{
+    return glm::length(position - eye_);
+}
+
+void RenderQueue::add(const Item& item)
+{
+    items_.push_back(item);
+}
+
+uint64_t RenderQueue::makeKey(const Item& item)
+{
+    uint64_t key = uint64_t(item.layer & 0xF) << LAYER_SHIFT;
+    uint64_t program = (item.shader != nullptr ? item.shader->id() : 0) & PROGRAM_MASK;
+    uint64_t depth = depthBits(item.depth);
+    if (!item.transparent) {
+        return key | program << OPAQUE_PROGRAM_SHIFT | uint64_t(item.material) << OPAQUE_MATERIAL_SHIFT |
+               depth << OPAQUE_DEPTH_SHIFT;
+    }
+    // Farthest first: the inverted depth leads, state only breaks ties.
+    key |= uint64_t(1) << TRANSPARENT_SHIFT;
+    return key | (~depth & DEPTH_MASK) << TRANSPARENT_DEPTH_SHIFT | program << TRANSPARENT_PROGRAM_SHIFT |
+           uint64_t(item.material) << TRANSPARENT_MATERIAL_SHIFT;
+}
+
+void RenderQueue::radixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch)
+{
+    scratch.resize(entries.size());
+    for (int shift = 0; shift < 64; shift += 8) {
+        size_t counts[256] = {};
+        for (const Entry& entry : entries) {
+            ++counts[(entry.key >> shift) & 0xFF];
+        }
+        if (counts[(entries[0].key >> shift) & 0xFF] == entries.size()) {
+            continue;
+        }
+        size_t offset = 0;
+        for (size_t& count : counts) {
+            size_t next = offset + count;
+            count = offset;
+            offset = next;
+        }
+        for (const Entry& entry : entries) {
+            scratch[counts[(entry.key >> shift) & 0xFF]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::submit()
+{
+    if (items_.empty()) {
+        return;
+    }
+    entries_.clear();
+    for (size_t i = 0; i < items_.size(); ++i) {
+        entries_.push_back({makeKey(items_[i]), static_cast<uint32_t>(i)});
+    }
+    radixSort(entries_, scratch_);
+
+    constexpr UniformName MODEL_UNIFORM("model");
+    GlState& state = GlState::shared();
+    Shader* shader = nullptr;
+    Uniform model;
+    for (const Entry& entry : entries_) {
+        Item& item = items_[entry.item];
+        if (item.pipeline != nullptr) {
+            state.apply(*item.pipeline);
+        }
+        if (item.shader != shader) {
+            shader = item.shader;
+            shader->use();
+            model = shader->uniform(MODEL_UNIFORM);
+        }
+        shader->setMat4(model, item.transform);
+        if (item.mesh != nullptr) {
+            if (item.instances != nullptr) {
+                item.mesh->drawInstanced(*shader, *item.instances);
+            } else {
+                item.mesh->draw(*shader);
+            }
+            continue;
+        }
+        if (item.texture != 0) {
+            state.bindTexture(0, item.texture_target, item.texture);
+        }
+        if (item.instances != nullptr) {
+            item.instances->draw(item.vertex_array, item.vertex_count);
+        } else {
+            state.bindVertexArray(item.vertex_array);
+            glDrawArrays(GL_TRIANGLES, 0, item.vertex_count);
+        }
+    }
+    items_.clear();
+}
@@ -0,0 +1,73 @@
+#pragma once
+#ifndef RENDER_QUEUE_H
+#define RENDER_QUEUE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glad/glad.h>
+#include <glm.hpp>
+
+#include "gl_state.h"
+#include "instance_buffer.h"
+#include "shader.h"
+
+class Mesh;
+
+// Draws collected over a frame, then sorted by a 64-bit key and submitted in that order, so consecutive draws share
+// as much state as possible. From the most significant bits down:
+//     layer (4) | transparent (1) | program (12) | material (16) | depth (24)     opaque, front to back
+//     layer (4) | transparent (1) | ~depth (24) | program (12) | material (16)    transparent, back to front
+// Layers run in order, and within one all opaque items come before the transparent ones. GL thread only, the
+// buffers are reused so a steady frame doesn't allocate.
+class RenderQueue {
+public:
+    struct Item {
+        uint8_t layer = 0;  // 0 to 15.
+        bool transparent = false;
+        const PipelineState* pipeline = nullptr;  // Left as it is when null.
+        Shader* shader = nullptr;
+        uint16_t material = 0;  // Items with the same material bind the same textures, see Mesh::materialKey.
+        float depth = 0.0f;     // Distance from the eye, see begin().
+        glm::mat4 transform = glm::mat4(1.0f);  // Set as the "model" uniform.
+        // What to draw: the mesh, or else `vertex_count` vertices of `vertex_array` as triangles with `texture`
+        // bound on unit 0.
+        Mesh* mesh = nullptr;
+        GLuint vertex_array = 0;
+        GLenum texture_target = GL_TEXTURE_2D;
+        GLuint texture = 0;
+        GLsizei vertex_count = 0;
+        // Draws it once per transform in the buffer, on top of `transform`, with the INSTANCED permutation of the
+        // shader. The instances aren't sorted, they are drawn in buffer order.
+        const InstanceBuffer* instances = nullptr;
+    };
+
+    // Starts a frame seen from `eye`, the point depths are measured from.
+    void begin(const glm::vec3& eye);
+    const glm::vec3& eye() const { return eye_; }
+    // Distance from the eye to `position` (world space), for Item::depth.
+    float depthOf(const glm::vec3& position) const;
+    void add(const Item& item);
+    // Sorts, draws everything in key order and empties the queue.
+    void submit();
+    size_t size() const { return items_.size(); }
+
+    static uint64_t makeKey(const Item& item);
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t item;
+    };
+
+    // Least significant digit first, 8 bits per pass. Passes where every key has the same digit are skipped.
+    static void radixSort(std::vector<Entry>& entries, std::vector<Entry>& scratch);
+
+    glm::vec3 eye_ = glm::vec3(0.0f);
+    std::vector<Item> items_;
+    std::vector<Entry> entries_;
+    std::vector<Entry> scratch_;
+};
+
+#endif
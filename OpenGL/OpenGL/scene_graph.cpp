@@ -0,0 +1,50 @@
+#include "scene_graph.h"
+
+#include <algorithm>
+
+uint32_t SceneGraph::addNode(int32_t parent, const glm::mat4& local)
+{
+    parents_.push_back(parent);
+    local_.push_back(local);
+    world_.push_back(parent == NO_PARENT ? local : world_[parent] * local);
+    dirty_.push_back(0);
+    return static_cast<uint32_t>(parents_.size() - 1);
+}
+
+void SceneGraph::clear()
+{
+    parents_.clear();
+    local_.clear();
+    world_.clear();
+    dirty_.clear();
+    any_dirty_ = false;
+}
+
+void SceneGraph::setLocal(uint32_t node, const glm::mat4& local)
+{
+    local_[node] = local;
+    dirty_[node] = 1;
+    any_dirty_ = true;
+}
+
+size_t SceneGraph::updateWorld()
+{
+    if (!any_dirty_) {
+        return 0;
+    }
+    // Parents come first, so a dirty parent has already passed its flag on when its children are reached.
+    size_t updated = 0;
+    for (size_t i = 0; i < parents_.size(); ++i) {
+        int32_t parent = parents_[i];
+        if (parent != NO_PARENT) {
+            dirty_[i] |= dirty_[parent];
+        }
+        if (dirty_[i]) {
+            world_[i] = parent == NO_PARENT ? local_[i] : world_[parent] * local_[i];
+            ++updated;
+        }
+    }
+    std::fill(dirty_.begin(), dirty_.end(), 0);
+    any_dirty_ = false;
+    return updated;
+}
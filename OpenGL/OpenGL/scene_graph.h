@@ -0,0 +1,48 @@
+#pragma once
+#ifndef SCENE_GRAPH_H
+#define SCENE_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm.hpp>
+
+// Node hierarchy of a model flattened depth-first, so every parent comes before its children, and stored as
+// parallel arrays. Updating world transforms is then a single forward pass over contiguous memory.
+class SceneGraph {
+public:
+    static const int32_t NO_PARENT = -1;
+
+    // Appends a node below `parent`, which has to be in the graph already.
+    uint32_t addNode(int32_t parent, const glm::mat4& local);
+    void clear();
+
+    size_t size() const { return parents_.size(); }
+    int32_t parent(uint32_t node) const { return parents_[node]; }
+    const glm::mat4& local(uint32_t node) const { return local_[node]; }
+    // Valid after updateWorld().
+    const glm::mat4& world(uint32_t node) const { return world_[node]; }
+    const std::vector<int32_t>& parents() const { return parents_; }
+    const std::vector<glm::mat4>& localTransforms() const { return local_; }
+
+    // Marks the node, and through it its subtree, for the next updateWorld().
+    void setLocal(uint32_t node, const glm::mat4& local);
+    // Recomputes the world transforms of the dirty nodes and their descendants, returns how many changed.
+    size_t updateWorld();
+
+private:
+    std::vector<int32_t> parents_;
+    std::vector<glm::mat4> local_;
+    std::vector<glm::mat4> world_;
+    std::vector<uint8_t> dirty_;
+    bool any_dirty_ = false;
+};
+
+// A mesh drawn with the world transform of a node. Several nodes may reference the same mesh.
+struct MeshInstance {
+    uint32_t node = 0;
+    uint32_t mesh = 0;
+};
+
+#endif
@@ -1,113 +1,241 @@
 #include "shader.h"
 
-Shader::Shader(const char* vertex_path, const char* fragment_path)
-{
-    std::string vertex_code;
-    std::string fragment_code;
-    std::ifstream vertex_shader_file;
-    std::ifstream fragment_shader_file;
-
-    vertex_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-    fragment_shader_file.exceptions(std::ifstream::failbit | std::ifstream::badbit);
-
-    try {
-        vertex_shader_file.open(vertex_path);
-        fragment_shader_file.open(fragment_path);
-
-        // Reading.
-        std::stringstream vertexShaderStream;
-        std::stringstream fragmentShaderStream;
-        vertexShaderStream << vertex_shader_file.rdbuf();
-        fragmentShaderStream << fragment_shader_file.rdbuf();
-
-        vertex_shader_file.close();
-        fragment_shader_file.close();
-
-        // Get the string of file.
-        vertex_code = vertexShaderStream.str();
-        fragment_code = fragmentShaderStream.str();
-    } catch (std::ifstream::failure e) {
-        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ" << std::endl;
+#include <algorithm>
+
+#include "frame_uniforms.h"
+#include "gl_state.h"
+#include "program_cache.h"
+#include "shader_compile_queue.h"
+
+Shader::Shader(const char* vertex_path, const char* fragment_path, const ShaderDefines& defines)
+{
+    begin(vertex_path, fragment_path, defines);
+    finish();
+}
+
+Shader Shader::submit(const char* vertex_path, const char* fragment_path, const ShaderDefines& defines)
+{
+    Shader shader;
+    shader.begin(vertex_path, fragment_path, defines);
+    return shader;
+}
+
+void Shader::begin(const char* vertex_path, const char* fragment_path, const ShaderDefines& defines)
+{
+    // Reading, with the includes spliced in and the defines after #version.
+    ShaderSource::Source vertex_source;
+    ShaderSource::Source fragment_source;
+    std::string error;
+    if (!ShaderSource::load(vertex_path, defines, vertex_source, error) ||
+        !ShaderSource::load(fragment_path, defines, fragment_source, error)) {
+        std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ " << error << std::endl;
+    }
+    const std::string& vertex_code = vertex_source.text;
+    const std::string& fragment_code = fragment_source.text;
+
+    // Skip compiling and linking when this driver already linked the same sources before.
+    uint64_t cache_key = ProgramCache::makeKey(vertex_code, fragment_code, ShaderSource::definesText(defines));
+    program_ = GlProgram::create();
+    if (ProgramCache::load(program_.get(), cache_key)) {
+        setupLinkedProgram();
+        status_ = Status::READY;
+        return;
     }
 
     const char* vertex_shader_code = vertex_code.c_str();
     const char* fragment_shader_code = fragment_code.c_str();
 
+    // Compile and link without asking for any result, so a driver compiling on its own threads isn't stalled.
+    compile_.reset(new PendingCompile());
+    compile_->vertex = GlShader(glCreateShader(GL_VERTEX_SHADER));
+    glShaderSource(compile_->vertex.get(), 1, &vertex_shader_code, NULL);
+    glCompileShader(compile_->vertex.get());
+    compile_->fragment = GlShader(glCreateShader(GL_FRAGMENT_SHADER));
+    glShaderSource(compile_->fragment.get(), 1, &fragment_shader_code, NULL);
+    glCompileShader(compile_->fragment.get());
+    compile_->vertex_files = std::move(vertex_source.files);
+    compile_->fragment_files = std::move(fragment_source.files);
+    compile_->cache_key = cache_key;
+
+    // Link the shader program. A fresh one, a rejected cached binary may have left the other in a failed state.
+    program_ = GlProgram::create();
+    glAttachShader(program_.get(), compile_->vertex.get());
+    glAttachShader(program_.get(), compile_->fragment.get());
+    ProgramCache::prepare(program_.get());
+    glLinkProgram(program_.get());
+    status_ = Status::PENDING;
+}
+
+bool Shader::ready()
+{
+    if (status_ == Status::PENDING && ShaderCompileQueue::parallelCompileSupported()) {
+        GLint completed = GL_FALSE;
+        glGetProgramiv(program_.get(), GL_COMPLETION_STATUS_KHR, &completed);
+        if (completed) {
+            finish();
+        }
+    }
+    return status_ == Status::READY;
+}
+
+void Shader::finish()
+{
+    if (status_ != Status::PENDING) {
+        return;
+    }
     int success;
     char info_log[512];
 
-    // Compile vertex shader.
-    unsigned int vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertex_shader, 1, &vertex_shader_code, NULL);
-    glCompileShader(vertex_shader);
-    glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(compile_->vertex.get(), GL_COMPILE_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(vertex_shader, 512, NULL, info_log);
+        glGetShaderInfoLog(compile_->vertex.get(), 512, NULL, info_log);
         std::cout << "ERROR:SHADER::VERTEX::COMPILATION_FAILED\n" << info_log << std::endl;
+        printSourceFiles(compile_->vertex_files);
     }
-    
-    // Compile fragment shader.
-    unsigned int fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragment_shader, 1, &fragment_shader_code, NULL);
-    glCompileShader(fragment_shader);
-    glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &success);
+    glGetShaderiv(compile_->fragment.get(), GL_COMPILE_STATUS, &success);
     if (!success) {
-        glGetShaderInfoLog(fragment_shader, 512, NULL, info_log);
+        glGetShaderInfoLog(compile_->fragment.get(), 512, NULL, info_log);
         std::cout << "ERROR:SHADER::FRAGMENT::COMPILATION_FAILED\n" << info_log << std::endl;
+        printSourceFiles(compile_->fragment_files);
     }
 
-    // Link the shader program.
-    shader_program = glCreateProgram();
-    glAttachShader(shader_program, vertex_shader);
-    glAttachShader(shader_program, fragment_shader);
-    glLinkProgram(shader_program);
-
-    glGetProgramiv(shader_program, GL_LINK_STATUS, &success);
+    glGetProgramiv(program_.get(), GL_LINK_STATUS, &success);
     if (!success) {
-        glGetProgramInfoLog(shader_program, 512, NULL, info_log);
+        glGetProgramInfoLog(program_.get(), 512, NULL, info_log);
         std::cout << "ERROR::SHADER::PROGRAM::LINKING_FAILED\n" << info_log << std::endl;
+        status_ = Status::FAILED;
+    } else {
+        setupLinkedProgram();
+        ProgramCache::store(program_.get(), compile_->cache_key);
+        status_ = Status::READY;
     }
-    // Delete shaders.
-    glDeleteShader(vertex_shader);
-    glDeleteShader(fragment_shader);
+    // The shader objects are deleted with the pending compile.
+    compile_.reset();
 }
 
-Shader::~Shader() {
-    glDeleteProgram(shader_program);
+void Shader::printSourceFiles(const std::vector<std::string>& files)
+{
+    // The log numbers lines per file as "<file>:<line>" or "<file>(<line>)", depending on the driver.
+    for (size_t i = 0; i < files.size(); ++i) {
+        std::cout << "  file " << i << ": " << files[i] << std::endl;
+    }
+}
+
+void Shader::setupLinkedProgram()
+{
+    cacheUniformLocations();
+    // Programs declaring the per-frame block read it from the shared buffer.
+    GLuint frame_block = glGetUniformBlockIndex(program_.get(), FrameUniforms::BLOCK_NAME);
+    if (frame_block != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program_.get(), frame_block, FrameUniforms::BINDING);
+    }
 }
 
 void Shader::use()
 {
-    glUseProgram(shader_program);
+    GlState::shared().useProgram(program_.get());
 }
 
-void Shader::setBool(const std::string& name, bool value) const
+void Shader::cacheUniformLocations()
 {
-    glUniform1i(glGetUniformLocation(shader_program, name.c_str()), (int)value);
+    GLint count = 0;
+    GLint max_length = 0;
+    glGetProgramiv(program_.get(), GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program_.get(), GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+    std::string name(std::max(max_length, 1), '\0');
+    locations_.clear();
+    for (GLint i = 0; i < count; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program_.get(), i, static_cast<GLsizei>(name.size()), &length, &size, &type, &name[0]);
+        std::string active(name.data(), length);
+        // Arrays are listed once as "name[0]": register the bare name and every element.
+        const std::string first_element = "[0]";
+        if (active.size() > first_element.size() &&
+            active.compare(active.size() - first_element.size(), first_element.size(), first_element) == 0) {
+            std::string base = active.substr(0, active.size() - first_element.size());
+            for (GLint element = 0; element < size; ++element) {
+                std::string element_name = base + '[' + std::to_string(element) + ']';
+                GLint location = glGetUniformLocation(program_.get(), element_name.c_str());
+                locations_[fnv1aString(element_name.c_str())] = location;
+                if (element == 0) {
+                    locations_[fnv1aString(base.c_str())] = location;
+                }
+            }
+        } else {
+            // Members of uniform blocks have no location, -1 is what they would get anyway.
+            locations_[fnv1aString(active.c_str())] = glGetUniformLocation(program_.get(), active.c_str());
+        }
+    }
 }
 
-void Shader::setInt(const std::string& name, int value) const
+Uniform Shader::uniform(UniformName name) const
 {
-    glUniform1i(glGetUniformLocation(shader_program, name.c_str()), value);
+    auto found = locations_.find(name.hash);
+    Uniform uniform;
+    if (found != locations_.end()) {
+        uniform.location = found->second;
+    }
+    return uniform;
 }
 
-void Shader::setFloat(const std::string& name, float value) const
+void Shader::setBool(const char* name, bool value) const
 {
-    glUniform1f(glGetUniformLocation(shader_program, name.c_str()), value);
+    setBool(uniform(name), value);
 }
 
+void Shader::setInt(const char* name, int value) const
+{
+    setInt(uniform(name), value);
+}
 
-void Shader::setMat4(const std::string& name, const glm::mat4& value) const
+void Shader::setFloat(const char* name, float value) const
 {
-    glUniformMatrix4fv(glGetUniformLocation(shader_program, name.c_str()), 1, GL_FALSE, glm::value_ptr(value));
+    setFloat(uniform(name), value);
 }
 
-void Shader::setVec3(const std::string& name, float x, float y, float z) const
+void Shader::setMat4(const char* name, const glm::mat4& value) const
 {
-    glUniform3f(glGetUniformLocation(shader_program, name.c_str()), x, y, z);
+    setMat4(uniform(name), value);
 }
 
-void Shader::setVec3(const std::string& name, const glm::vec3& value) const
+void Shader::setVec3(const char* name, float x, float y, float z) const
 {
-    glUniform3fv(glGetUniformLocation(shader_program, name.c_str()), 1, &value[0]);
-}
\ No newline at end of file
+    setVec3(uniform(name), x, y, z);
+}
+
+void Shader::setVec3(const char* name, const glm::vec3& value) const
+{
+    setVec3(uniform(name), value);
+}
+
+void Shader::setBool(Uniform uniform, bool value) const
+{
+    glUniform1i(uniform.location, (int)value);
+}
+
+void Shader::setInt(Uniform uniform, int value) const
+{
+    glUniform1i(uniform.location, value);
+}
+
+void Shader::setFloat(Uniform uniform, float value) const
+{
+    glUniform1f(uniform.location, value);
+}
+
+void Shader::setMat4(Uniform uniform, const glm::mat4& value) const
+{
+    glUniformMatrix4fv(uniform.location, 1, GL_FALSE, glm::value_ptr(value));
+}
+
+void Shader::setVec3(Uniform uniform, float x, float y, float z) const
+{
+    glUniform3f(uniform.location, x, y, z);
+}
+
+void Shader::setVec3(Uniform uniform, const glm::vec3& value) const
+{
+    glUniform3fv(uniform.location, 1, &value[0]);
+}
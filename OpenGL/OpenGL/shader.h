@@ -5,26 +5,108 @@
 #include <glad/glad.h>
 #include <gtc/type_ptr.hpp>
 
+#include "gl_handle.h"
+#include "hash.h"
+#include "shader_source.h"
+
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+// Name of a uniform, hashed once. Constant names hash at compile time:
+//     constexpr UniformName MODEL("model");
+struct UniformName {
+    constexpr UniformName(const char* name) : hash(fnv1aString(name)) {}
+    UniformName(const std::string& name) : hash(fnv1aString(name.c_str())) {}
+    uint64_t hash;
+};
+
+// Location of a uniform in one program, see Shader::uniform. -1 if the program doesn't use it, setting that is a
+// no-op like in GL.
+struct Uniform {
+    GLint location = -1;
+};
 
+// Owns its program, so it can be moved but not copied. Pass it by reference.
+// The locations of all active uniforms are looked up once after linking, setters never ask the driver.
 class Shader {
 public:
-    unsigned int shader_program;
+    // Both files go through ShaderSource, so they may #include others. `defines` select the permutation.
+    // Waits for the driver to compile and link, see submit() for the version that doesn't.
+    Shader(const char* vertexPath, const char* fragmentPath, const ShaderDefines& defines = ShaderDefines());
+    // Hands the sources to the driver and returns without waiting for the compile or link results. Poll ready()
+    // before drawing with it, using an unfinished program makes the driver wait for it. See ShaderCompileQueue.
+    static Shader submit(const char* vertexPath, const char* fragmentPath,
+                         const ShaderDefines& defines = ShaderDefines());
+    Shader(Shader&&) = default;
+    Shader& operator=(Shader&&) = default;
+    Shader(const Shader&) = delete;
+    Shader& operator=(const Shader&) = delete;
 
-    Shader(const char* vertexPath, const char* fragmentPath);
-    ~Shader();
+    unsigned int id() const { return program_.get(); }
+
+    // Whether the program is linked and usable. Never blocks: with KHR_parallel_shader_compile it asks the driver
+    // whether it is done and finishes the program if so, without it the program stays pending until finish().
+    bool ready();
+    // Waits for the driver, then checks the results and sets the program up. Nothing to do once it isn't pending.
+    void finish();
+    bool pending() const { return status_ == Status::PENDING; }
+    bool failed() const { return status_ == Status::FAILED; }
 
     void use();
     // uniform ߺ
-    void setBool(const std::string& name, bool value) const;
-    void setInt(const std::string& name, int value) const;
-    void setFloat(const std::string& name, float value) const;
-    void setMat4(const std::string& name, const glm::mat4& value) const;
-    void setVec3(const std::string& name, float x, float y, float z) const;
-    void setVec3(const std::string& name, const glm::vec3& value) const;
+    // Literal names go straight to GL without building a std::string, so the draw paths don't allocate.
+    void setBool(const char* name, bool value) const;
+    void setInt(const char* name, int value) const;
+    void setFloat(const char* name, float value) const;
+    void setMat4(const char* name, const glm::mat4& value) const;
+    void setVec3(const char* name, float x, float y, float z) const;
+    void setVec3(const char* name, const glm::vec3& value) const;
+    void setBool(const std::string& name, bool value) const { setBool(name.c_str(), value); }
+    void setInt(const std::string& name, int value) const { setInt(name.c_str(), value); }
+    void setFloat(const std::string& name, float value) const { setFloat(name.c_str(), value); }
+    void setMat4(const std::string& name, const glm::mat4& value) const { setMat4(name.c_str(), value); }
+    void setVec3(const std::string& name, float x, float y, float z) const { setVec3(name.c_str(), x, y, z); }
+    void setVec3(const std::string& name, const glm::vec3& value) const { setVec3(name.c_str(), value); }
+
+    // Resolve uniforms used every frame once and set them through the handle, that skips hashing the name too.
+    Uniform uniform(UniformName name) const;
+    void setBool(Uniform uniform, bool value) const;
+    void setInt(Uniform uniform, int value) const;
+    void setFloat(Uniform uniform, float value) const;
+    void setMat4(Uniform uniform, const glm::mat4& value) const;
+    void setVec3(Uniform uniform, float x, float y, float z) const;
+    void setVec3(Uniform uniform, const glm::vec3& value) const;
+
+private:
+    enum class Status : uint8_t { PENDING, READY, FAILED };
+
+    // What finish() needs from a submitted compile.
+    struct PendingCompile {
+        GlShader vertex;
+        GlShader fragment;
+        std::vector<std::string> vertex_files;
+        std::vector<std::string> fragment_files;
+        uint64_t cache_key = 0;
+    };
+
+    Shader() = default;
+    // Reads the sources and either loads the program from the ProgramCache or starts compiling and linking it.
+    void begin(const char* vertex_path, const char* fragment_path, const ShaderDefines& defines);
+    static void printSourceFiles(const std::vector<std::string>& files);
+    // Everything a program needs after linking, whether from source or from the ProgramCache.
+    void setupLinkedProgram();
+    // Fills locations_ from the program's active uniforms.
+    void cacheUniformLocations();
+
+    GlProgram program_;
+    Status status_ = Status::PENDING;
+    std::unique_ptr<PendingCompile> compile_;  // Only while pending.
+    std::unordered_map<uint64_t, GLint> locations_;  // By UniformName hash.
     ;};
 
 #endif
\ No newline at end of file
@@ -0,0 +1,79 @@
+#include "shader_compile_queue.h"
+
+#include <GLFW/glfw3.h>
+
+namespace {
+    typedef void(APIENTRYP MaxShaderCompilerThreadsProc)(GLuint count);
+}  // namespace
+
+Shader& ShaderCompileQueue::submit(const std::string& vertex_path, const std::string& fragment_path,
+                                   const ShaderDefines& defines)
+{
+    shaders_.push_back(Shader::submit(vertex_path.c_str(), fragment_path.c_str(), defines));
+    return shaders_.back();
+}
+
+size_t ShaderCompileQueue::process()
+{
+    bool parallel = parallelCompileSupported();
+    bool finished = false;
+    size_t pending = 0;
+    for (Shader& shader : shaders_) {
+        if (!shader.pending()) {
+            continue;
+        }
+        if (parallel) {
+            shader.ready();
+        } else if (!finished) {
+            // The driver may not have started yet, this is where the frame pays for it.
+            shader.finish();
+            finished = true;
+        }
+        if (shader.pending()) {
+            ++pending;
+        }
+    }
+    return pending;
+}
+
+void ShaderCompileQueue::finishAll()
+{
+    for (Shader& shader : shaders_) {
+        shader.finish();
+    }
+}
+
+size_t ShaderCompileQueue::pending() const
+{
+    size_t pending = 0;
+    for (const Shader& shader : shaders_) {
+        if (shader.pending()) {
+            ++pending;
+        }
+    }
+    return pending;
+}
+
+Shader& ShaderCompileQueue::select(Shader& shader, Shader& fallback)
+{
+    return shader.ready() ? shader : fallback;
+}
+
+bool ShaderCompileQueue::parallelCompileSupported()
+{
+    static const bool supported = []() {
+        MaxShaderCompilerThreadsProc max_threads = nullptr;
+        if (glfwExtensionSupported("GL_KHR_parallel_shader_compile")) {
+            max_threads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+        } else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile")) {
+            max_threads = (MaxShaderCompilerThreadsProc)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+        }
+        if (max_threads == nullptr) {
+            return false;
+        }
+        // 0xFFFFFFFF leaves the thread count to the driver.
+        max_threads(0xFFFFFFFFu);
+        return true;
+    }();
+    return supported;
+}
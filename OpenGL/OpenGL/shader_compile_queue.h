@@ -0,0 +1,51 @@
+#pragma once
+#ifndef SHADER_COMPILE_QUEUE_H
+#define SHADER_COMPILE_QUEUE_H
+
+#include <cstddef>
+#include <deque>
+#include <string>
+
+#include "shader.h"
+#include "shader_source.h"
+
+// KHR_parallel_shader_compile, missing from the 3.3 loader. ARB_parallel_shader_compile uses the same values.
+#ifndef GL_MAX_SHADER_COMPILER_THREADS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR 0x91B0
+#endif
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+// Programs submitted up front, so the driver compiles them while the caller goes on loading assets. With
+// KHR_parallel_shader_compile the driver compiles on its own threads and process() only polls. Without it
+// process() finishes one program per call, spreading the stalls over several frames.
+class ShaderCompileQueue {
+public:
+    ShaderCompileQueue() = default;
+    ShaderCompileQueue(const ShaderCompileQueue&) = delete;
+    ShaderCompileQueue& operator=(const ShaderCompileQueue&) = delete;
+
+    // GL thread. Reads the sources and hands them to the driver, see Shader::submit. The program is owned by the
+    // queue and stays where it is for the queue's lifetime.
+    Shader& submit(const std::string& vertex_path, const std::string& fragment_path,
+                   const ShaderDefines& defines = ShaderDefines());
+    // GL thread, once per frame. Finishes the programs the driver is done with, returns how many are still pending.
+    size_t process();
+    // Waits for every program.
+    void finishAll();
+    size_t pending() const;
+
+    // `shader` once it is ready, `fallback` until then. The fallback has to be usable itself, e.g. built with the
+    // blocking Shader constructor. Draws that have no fallback check Shader::ready() and skip.
+    static Shader& select(Shader& shader, Shader& fallback);
+
+    // Whether the driver compiles in the background. Asks it to use as many threads as it likes on first call, the
+    // context has to be current by then.
+    static bool parallelCompileSupported();
+
+private:
+    std::deque<Shader> shaders_;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include "shader_source.h"
+
+#include <filesystem>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+#include "hash.h"
+
+namespace ShaderSource {
+    namespace {
+        struct Context {
+            explicit Context(Source& source) : source(source) {}
+
+            Source& source;
+            std::set<std::string> included;
+            std::vector<std::string> stack;  // Files being expanded, to catch include cycles.
+            std::string error;
+        };
+
+        // `include` relative to the directory of `from`, normalized so that every route to a file yields one name.
+        std::string resolve(const std::string& from, const std::string& include)
+        {
+            std::filesystem::path path = std::filesystem::path(from).parent_path() / include;
+            return path.lexically_normal().generic_string();
+        }
+
+        bool readFile(const std::string& path, std::string& text)
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                return false;
+            }
+            std::stringstream stream;
+            stream << file.rdbuf();
+            text = stream.str();
+            return true;
+        }
+
+        // The quoted path of an `#include "..."` line, empty for any other line.
+        std::string includePath(const std::string& line)
+        {
+            size_t start = line.find_first_not_of(" \t");
+            if (start == std::string::npos || line.compare(start, 8, "#include") != 0) {
+                return std::string();
+            }
+            size_t open = line.find('"', start + 8);
+            size_t close = open == std::string::npos ? open : line.find('"', open + 1);
+            if (close == std::string::npos) {
+                return std::string();
+            }
+            return line.substr(open + 1, close - open - 1);
+        }
+
+        bool isVersion(const std::string& line)
+        {
+            size_t start = line.find_first_not_of(" \t");
+            return start != std::string::npos && line.compare(start, 8, "#version") == 0;
+        }
+
+        bool expand(Context& context, const std::string& path, const std::string& defines)
+        {
+            for (const std::string& open : context.stack) {
+                if (open == path) {
+                    context.error = "include cycle at " + path;
+                    return false;
+                }
+            }
+            if (!context.included.insert(path).second) {
+                return true;
+            }
+            std::string text;
+            if (!readFile(path, text)) {
+                context.error = "can't read " + path;
+                return false;
+            }
+
+            context.stack.push_back(path);
+            size_t file_number = context.source.files.size();
+            context.source.files.push_back(path);
+            std::string& out = context.source.text;
+            if (file_number > 0) {
+                out += "#line 1 " + std::to_string(file_number) + "\n";
+            }
+
+            std::istringstream lines(text);
+            std::string line;
+            size_t line_number = 0;
+            bool defines_pending = file_number == 0 && !defines.empty();
+            while (std::getline(lines, line)) {
+                ++line_number;
+                std::string include = includePath(line);
+                if (include.empty()) {
+                    out += line;
+                    out += '\n';
+                    if (defines_pending && isVersion(line)) {
+                        out += defines;
+                        out += "#line " + std::to_string(line_number + 1) + " " + std::to_string(file_number) + "\n";
+                        defines_pending = false;
+                    }
+                    continue;
+                }
+                if (!expand(context, resolve(path, include), defines)) {
+                    return false;
+                }
+                out += "#line " + std::to_string(line_number + 1) + " " + std::to_string(file_number) + "\n";
+            }
+            if (defines_pending) {
+                // No #version line, the defines still have to come before any use.
+                out.insert(0, defines + "#line 1 0\n");
+            }
+            context.stack.pop_back();
+            return true;
+        }
+    }  // namespace
+
+    bool load(const std::string& path, const ShaderDefines& defines, Source& source, std::string& error)
+    {
+        source = Source();
+        Context context(source);
+        if (!expand(context, std::filesystem::path(path).lexically_normal().generic_string(), definesText(defines))) {
+            error = context.error;
+            return false;
+        }
+        return true;
+    }
+
+    std::string definesText(const ShaderDefines& defines)
+    {
+        std::string text;
+        for (const auto& define : defines) {
+            text += "#define " + define.first + " " + define.second + "\n";
+        }
+        return text;
+    }
+
+    uint64_t hashDefines(const ShaderDefines& defines)
+    {
+        uint64_t hash = FNV_OFFSET_BASIS;
+        for (const auto& define : defines) {
+            // The separators keep {"AB", "C"} and {"A", "BC"} apart.
+            hash = fnv1a(define.first.data(), define.first.size(), hash);
+            hash = fnv1a("=", 1, hash);
+            hash = fnv1a(define.second.data(), define.second.size(), hash);
+            hash = fnv1a("\n", 1, hash);
+        }
+        return hash;
+    }
+}  // namespace ShaderSource
@@ -0,0 +1,33 @@
+#pragma once
+#ifndef SHADER_SOURCE_H
+#define SHADER_SOURCE_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Compile-time switches of a shader permutation, name to value, each becoming "#define NAME VALUE". Ordered, so
+// equal sets always produce the same source and the same ProgramCache key.
+using ShaderDefines = std::map<std::string, std::string>;
+
+// GLSL preprocessing done before the source reaches the driver: `#include "file"` and defines.
+namespace ShaderSource {
+    struct Source {
+        std::string text;
+        // Files by GLSL source string number, as used by the #line directives and in the driver's error messages.
+        std::vector<std::string> files;
+    };
+
+    // Reads `path` and splices in every `#include "relative/path"`, resolved against the including file. Each file
+    // is included once per source, so shared files need no guards. `defines` go right after the #version line.
+    // Returns false and names the file in `error` when one can't be read or includes itself.
+    bool load(const std::string& path, const ShaderDefines& defines, Source& source, std::string& error);
+
+    // "#define NAME VALUE" lines of `defines`.
+    std::string definesText(const ShaderDefines& defines);
+    // Hash of `defines`, equal for equal sets. Doesn't allocate.
+    uint64_t hashDefines(const ShaderDefines& defines);
+}  // namespace ShaderSource
+
+#endif
@@ -0,0 +1,24 @@
+#include "shader_variants.h"
+
+#include <utility>
+
+ShaderVariants::ShaderVariants(std::string vertex_path, std::string fragment_path, Setup on_create)
+    : vertex_path_(std::move(vertex_path)), fragment_path_(std::move(fragment_path)),
+      on_create_(std::move(on_create))
+{
+}
+
+Shader& ShaderVariants::get(const ShaderDefines& defines)
+{
+    uint64_t key = ShaderSource::hashDefines(defines);
+    auto it = variants_.find(key);
+    if (it != variants_.end()) {
+        return it->second;
+    }
+    it = variants_.emplace(key, Shader(vertex_path_.c_str(), fragment_path_.c_str(), defines)).first;
+    if (on_create_) {
+        it->second.use();
+        on_create_(it->second, defines);
+    }
+    return it->second;
+}
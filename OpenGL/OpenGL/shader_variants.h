@@ -0,0 +1,38 @@
+#pragma once
+#ifndef SHADER_VARIANTS_H
+#define SHADER_VARIANTS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "shader.h"
+#include "shader_source.h"
+
+// The permutations of one vertex/fragment pair, compiled the first time a set of defines is asked for. Each is an
+// ordinary Shader, so warm runs load them from the ProgramCache.
+class ShaderVariants {
+public:
+    // `on_create` runs once per new variant, right after it is linked and made current, to set the uniforms that
+    // never change (sampler units, lights). It gets the defines the variant was built with.
+    using Setup = std::function<void(Shader& shader, const ShaderDefines& defines)>;
+
+    ShaderVariants(std::string vertex_path, std::string fragment_path, Setup on_create = Setup());
+    ShaderVariants(const ShaderVariants&) = delete;
+    ShaderVariants& operator=(const ShaderVariants&) = delete;
+
+    // The variant for `defines`, compiled on first use. Later lookups hash the defines and don't allocate.
+    Shader& get(const ShaderDefines& defines);
+    // Number of variants compiled so far.
+    size_t size() const { return variants_.size(); }
+
+private:
+    std::string vertex_path_;
+    std::string fragment_path_;
+    Setup on_create_;
+    std::unordered_map<uint64_t, Shader> variants_;
+};
+
+#endif
@@ -0,0 +1,33 @@
+#include "string_table.h"
+
+StringTable& StringTable::shared()
+{
+    // Never destroyed, ids may still be looked up from static destructors.
+    static StringTable* table = new StringTable();
+    return *table;
+}
+
+uint32_t StringTable::intern(const std::string& value)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto found = ids_.find(value);
+    if (found != ids_.end()) {
+        return found->second;
+    }
+    uint32_t id = static_cast<uint32_t>(strings_.size());
+    strings_.push_back(value);
+    ids_.emplace(value, id);
+    return id;
+}
+
+const std::string& StringTable::str(uint32_t id) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return strings_.at(id);
+}
+
+size_t StringTable::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return strings_.size();
+}
@@ -0,0 +1,30 @@
+#pragma once
+#ifndef STRING_TABLE_H
+#define STRING_TABLE_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+// Interns strings so that descriptors can hold a 32-bit id instead of a copy. Ids stay valid for the lifetime of
+// the table, strings are never removed. Safe to use from any thread.
+class StringTable {
+public:
+    // Table shared by the loaders, e.g. for texture paths.
+    static StringTable& shared();
+
+    // Id of `value`, adding it on first use.
+    uint32_t intern(const std::string& value);
+    // The string behind an id returned by intern(), the reference stays valid.
+    const std::string& str(uint32_t id) const;
+    size_t size() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::deque<std::string> strings_;  // By id, a deque so references survive growth.
+    std::unordered_map<std::string, uint32_t> ids_;
+};
+
+#endif
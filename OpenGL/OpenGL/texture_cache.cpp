@@ -0,0 +1,222 @@
+#include "texture_cache.h"
+
+#include <glad/glad.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+
+#include "hash.h"
+#include "texture_loader.h"
+
+namespace {
+    // Hashes 8 bytes per step, byte-wise FNV is too slow for megabytes of pixels.
+    uint64_t hashPixels(const TextureLoader::Image& image)
+    {
+        if (image.pixels == nullptr) {
+            return 0;
+        }
+        int header[3] = {image.width, image.height, image.channels};
+        uint64_t hash = fnv1a(header, sizeof(header));
+
+        size_t size = size_t(image.width) * image.height * image.channels;
+        size_t words = size / sizeof(uint64_t);
+        for (size_t i = 0; i < words; ++i) {
+            uint64_t word;
+            std::memcpy(&word, image.pixels + i * sizeof(uint64_t), sizeof(uint64_t));
+            hash = (hash ^ word) * 0x100000001b3ull;
+            hash ^= hash >> 29;
+        }
+        return fnv1a(image.pixels + words * sizeof(uint64_t), size - words * sizeof(uint64_t), hash);
+    }
+
+    std::string variantKey(const std::string& filename, bool flip_vertically)
+    {
+        std::string key = TextureCache::normalizePath(filename);
+        return flip_vertically ? key : key + "|noflip";
+    }
+}  // namespace
+
+TextureCache& TextureCache::instance()
+{
+    // Never destroyed, it owns GL objects, see GlHandle.
+    static TextureCache* cache = new TextureCache();
+    return *cache;
+}
+
+std::string TextureCache::normalizePath(const std::string& filename)
+{
+    std::error_code error;
+    std::filesystem::path path = std::filesystem::absolute(std::filesystem::path(filename), error);
+    if (error) {
+        path = std::filesystem::path(filename);
+    }
+    std::string normalized = path.lexically_normal().generic_string();
+#ifdef _WIN32
+    // NTFS paths are case-insensitive.
+    std::transform(normalized.begin(), normalized.end(), normalized.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+#endif
+    return normalized;
+}
+
+unsigned int TextureCache::find(const std::string& key)
+{
+    auto it = by_key_.find(key);
+    if (it == by_key_.end()) {
+        return 0;
+    }
+    ++entries_[it->second].refs;
+    ++stats_.path_hits;
+    return it->second;
+}
+
+unsigned int TextureCache::adopt(const std::string& key, Decoded& decoded)
+{
+    unsigned int texture = 0;
+    auto shared = by_pixels_.find(decoded.pixel_hash);
+    if (decoded.pixel_hash != 0 && shared != by_pixels_.end()) {
+        texture = shared->second;
+        ++stats_.content_hits;
+    } else {
+        texture = TextureLoader::upload2D(decoded.image);
+    }
+    TextureLoader::release(decoded.image);
+    addKey(key, texture, decoded.pixel_hash);
+    return texture;
+}
+
+void TextureCache::addKey(const std::string& key, unsigned int texture, uint64_t pixel_hash)
+{
+    Entry& entry = entries_[texture];
+    if (!entry.texture) {
+        entry.texture = GlTexture(texture);
+    }
+    ++entry.refs;
+    entry.keys.push_back(key);
+    by_key_[key] = texture;
+    if (pixel_hash != 0) {
+        entry.pixel_hash = pixel_hash;
+        by_pixels_.emplace(pixel_hash, texture);
+    }
+}
+
+bool TextureCache::contains(const std::string& filename, bool flip_vertically) const
+{
+    return by_key_.count(variantKey(filename, flip_vertically)) != 0;
+}
+
+TextureCache::Decoded TextureCache::decode(const std::string& filename, bool flip_vertically)
+{
+    ++decodes_;
+    Decoded decoded;
+    decoded.image = TextureLoader::decode(filename, flip_vertically);
+    decoded.pixel_hash = content_hashing_ ? hashPixels(decoded.image) : 0;
+    return decoded;
+}
+
+unsigned int TextureCache::insert(const std::string& filename, Decoded& decoded, bool flip_vertically)
+{
+    std::string key = variantKey(filename, flip_vertically);
+    // Another load may have finished the same file in the meantime.
+    if (unsigned int texture = find(key)) {
+        TextureLoader::release(decoded.image);
+        return texture;
+    }
+    return adopt(key, decoded);
+}
+
+unsigned int TextureCache::load2D(const std::string& filename, bool flip_vertically)
+{
+    std::string key = variantKey(filename, flip_vertically);
+    if (unsigned int texture = find(key)) {
+        return texture;
+    }
+    Decoded decoded = decode(filename, flip_vertically);
+    return adopt(key, decoded);
+}
+
+std::vector<unsigned int> TextureCache::load2D(const std::vector<std::string>& filenames, ThreadPool& pool,
+                                               bool flip_vertically)
+{
+    std::vector<unsigned int> textures(filenames.size(), 0);
+    std::vector<std::string> keys(filenames.size());
+
+    // Decode phase: one task per file that isn't cached yet, duplicates in the batch are decoded once.
+    std::unordered_map<std::string, std::future<Decoded>> pending;
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        keys[i] = variantKey(filenames[i], flip_vertically);
+        if (by_key_.count(keys[i]) != 0 || pending.count(keys[i]) != 0) {
+            continue;
+        }
+        const std::string& filename = filenames[i];
+        pending.emplace(keys[i], pool.submit([this, &filename, flip_vertically]() {
+            return decode(filename, flip_vertically);
+        }));
+    }
+
+    // Upload phase, in input order.
+    for (size_t i = 0; i < filenames.size(); ++i) {
+        auto it = pending.find(keys[i]);
+        if (it == pending.end()) {
+            textures[i] = find(keys[i]);
+            continue;
+        }
+        Decoded decoded = it->second.get();
+        pending.erase(it);
+        textures[i] = adopt(keys[i], decoded);
+    }
+    return textures;
+}
+
+unsigned int TextureCache::loadCubemap(const std::vector<std::string>& faces)
+{
+    std::string key = "cubemap:";
+    for (const std::string& face : faces) {
+        key += normalizePath(face) + '|';
+    }
+    if (unsigned int texture = find(key)) {
+        return texture;
+    }
+
+    std::vector<std::future<TextureLoader::Image>> pending;
+    for (const std::string& face : faces) {
+        pending.push_back(ThreadPool::shared().submit([&face]() { return TextureLoader::decode(face, false); }));
+        ++decodes_;
+    }
+    std::vector<TextureLoader::Image> images;
+    for (std::future<TextureLoader::Image>& image : pending) {
+        images.push_back(image.get());
+    }
+    unsigned int texture = TextureLoader::uploadCubemap(images);
+    for (TextureLoader::Image& image : images) {
+        TextureLoader::release(image);
+    }
+    addKey(key, texture, 0);
+    return texture;
+}
+
+void TextureCache::retain(unsigned int texture)
+{
+    auto it = entries_.find(texture);
+    if (it != entries_.end()) {
+        ++it->second.refs;
+    }
+}
+
+void TextureCache::release(unsigned int texture)
+{
+    auto it = entries_.find(texture);
+    if (it == entries_.end() || --it->second.refs > 0) {
+        return;
+    }
+    for (const std::string& key : it->second.keys) {
+        by_key_.erase(key);
+    }
+    if (it->second.pixel_hash != 0) {
+        by_pixels_.erase(it->second.pixel_hash);
+    }
+    // Deletes the texture.
+    entries_.erase(it);
+}
@@ -0,0 +1,84 @@
+#pragma once
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gl_handle.h"
+#include "texture_loader.h"
+#include "thread_pool.h"
+
+// Process-wide registry of GL textures keyed by normalized absolute path.
+// Every load adds a reference and every release drops one, the GL texture is deleted with the last reference.
+// With content hashing on, files holding identical pixels share one texture as well.
+// Must only be used on the GL thread, decoding is the only part handed to workers.
+class TextureCache {
+public:
+    // CPU result of a load, produced by decode() on any thread.
+    struct Decoded {
+        TextureLoader::Image image;
+        uint64_t pixel_hash = 0;
+    };
+
+    struct Stats {
+        size_t path_hits = 0;
+        size_t content_hits = 0;
+        size_t decodes = 0;
+    };
+
+    static TextureCache& instance();
+    static std::string normalizePath(const std::string& filename);
+
+    // Mipmapped, repeating 2D texture.
+    unsigned int load2D(const std::string& filename, bool flip_vertically = true);
+    // Decodes the files that aren't cached yet on the pool, ids are returned in input order.
+    std::vector<unsigned int> load2D(const std::vector<std::string>& filenames, ThreadPool& pool,
+                                     bool flip_vertically = true);
+    // Faces in +X, -X, +Y, -Y, +Z, -Z order.
+    unsigned int loadCubemap(const std::vector<std::string>& faces);
+
+    // Two-phase loading for callers that schedule the decodes themselves (async model loads): check contains() on
+    // the GL thread, decode() the missing files on any thread, then insert() them back on the GL thread.
+    bool contains(const std::string& filename, bool flip_vertically = true) const;
+    Decoded decode(const std::string& filename, bool flip_vertically = true);
+    // Takes over the decoded image and returns a referenced texture.
+    unsigned int insert(const std::string& filename, Decoded& decoded, bool flip_vertically = true);
+
+    void retain(unsigned int texture);
+    void release(unsigned int texture);
+
+    void setContentHashing(bool enabled) { content_hashing_ = enabled; }
+    size_t textureCount() const { return entries_.size(); }
+    Stats stats() const
+    {
+        Stats stats = stats_;
+        stats.decodes = decodes_;
+        return stats;
+    }
+
+private:
+    struct Entry {
+        GlTexture texture;
+        unsigned int refs = 0;
+        uint64_t pixel_hash = 0;
+        std::vector<std::string> keys;
+    };
+
+    TextureCache() = default;
+    unsigned int find(const std::string& key);
+    unsigned int adopt(const std::string& key, Decoded& decoded);
+    void addKey(const std::string& key, unsigned int texture, uint64_t pixel_hash);
+
+    std::unordered_map<std::string, unsigned int> by_key_;
+    std::unordered_map<uint64_t, unsigned int> by_pixels_;
+    std::unordered_map<unsigned int, Entry> entries_;
+    std::atomic<bool> content_hashing_{false};
+    std::atomic<size_t> decodes_{0};
+    Stats stats_;
+};
+
+#endif
@@ -0,0 +1,111 @@
+#include "texture_loader.h"
+
+#include <glad/glad.h>
+
+#include <iostream>
+
+#include "gl_state.h"
+#include "stb_image.h"
+
+namespace TextureLoader {
+    Image decode(const std::string& filename, bool flip_vertically)
+    {
+        // The flip flag is per thread so workers don't race on stb's global one.
+        stbi_set_flip_vertically_on_load_thread(flip_vertically);
+
+        Image image;
+        image.pixels = stbi_load(filename.c_str(), &image.width, &image.height, &image.channels, 0);
+        if (image.pixels == nullptr) {
+            std::cout << "Failed to load texture: " << filename << std::endl;
+        }
+        return image;
+    }
+
+    void release(Image& image)
+    {
+        // Recycle the image data.
+        stbi_image_free(image.pixels);
+        image.pixels = nullptr;
+    }
+
+    static GLenum pixelFormat(int channels)
+    {
+        if (channels == 1) {
+            return GL_RED;
+        } else if (channels == 2) {
+            return GL_RG;
+        } else if (channels == 4) {
+            return GL_RGBA;
+        }
+        return GL_RGB;
+    }
+
+    unsigned int upload2D(const Image& image)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        GlState::shared().bindTexture(GL_TEXTURE_2D, texture);
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+        if (image.pixels != nullptr) {
+            GLenum rgb_mode = pixelFormat(image.channels);
+            // Rows of 1 and 3 channel images aren't 4-byte aligned.
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            glTexImage2D(GL_TEXTURE_2D, 0, rgb_mode, image.width, image.height, 0, rgb_mode, GL_UNSIGNED_BYTE,
+                         image.pixels);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+            glGenerateMipmap(GL_TEXTURE_2D);
+        }
+        return texture;
+    }
+
+    unsigned int uploadCubemap(const std::vector<Image>& faces)
+    {
+        unsigned int texture;
+        glGenTextures(1, &texture);
+        GlState::shared().bindTexture(GL_TEXTURE_CUBE_MAP, texture);
+
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (unsigned int i = 0; i < faces.size(); ++i) {
+            const Image& face = faces[i];
+            if (face.pixels != nullptr) {
+                GLenum rgb_mode = pixelFormat(face.channels);
+                glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, rgb_mode, face.width, face.height, 0, rgb_mode,
+                             GL_UNSIGNED_BYTE, face.pixels);
+            }
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    std::vector<unsigned int> loadAll(const std::vector<std::string>& filenames, ThreadPool& pool,
+                                      bool flip_vertically)
+    {
+        std::vector<std::future<Image>> decoded;
+        decoded.reserve(filenames.size());
+        for (const std::string& filename : filenames) {
+            decoded.push_back(
+                pool.submit([&filename, flip_vertically]() { return decode(filename, flip_vertically); }));
+        }
+
+        // Upload in submission order, each one as soon as its decode is done.
+        std::vector<unsigned int> textures;
+        textures.reserve(filenames.size());
+        for (std::future<Image>& pending : decoded) {
+            Image image = pending.get();
+            textures.push_back(upload2D(image));
+            release(image);
+        }
+        return textures;
+    }
+}  // namespace TextureLoader
@@ -0,0 +1,33 @@
+#pragma once
+#ifndef TEXTURE_LOADER_H
+#define TEXTURE_LOADER_H
+
+#include <string>
+#include <vector>
+
+#include "thread_pool.h"
+
+// Texture loading split into a CPU decode phase, which is safe to run on worker threads, and a GL upload phase,
+// which has to run on the thread owning the context.
+namespace TextureLoader {
+    struct Image {
+        int width = 0;
+        int height = 0;
+        int channels = 0;
+        unsigned char* pixels = nullptr;
+    };
+
+    Image decode(const std::string& filename, bool flip_vertically = true);
+    void release(Image& image);
+
+    // Creates a mipmapped, repeating 2D texture. Returns the texture even if the image failed to decode.
+    unsigned int upload2D(const Image& image);
+    // Creates a clamped cube map from the +X, -X, +Y, -Y, +Z, -Z faces.
+    unsigned int uploadCubemap(const std::vector<Image>& faces);
+
+    // Decodes every file on the pool, then uploads them in order on the calling thread.
+    std::vector<unsigned int> loadAll(const std::vector<std::string>& filenames, ThreadPool& pool,
+                                      bool flip_vertically = true);
+}  // namespace TextureLoader
+
+#endif
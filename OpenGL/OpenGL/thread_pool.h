@@ -0,0 +1,60 @@
+#pragma once
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size pool of worker threads for CPU-only work (decoding, mesh conversion).
+// Tasks must not touch GL, the context is only current on the main thread.
+class ThreadPool {
+public:
+    // 0 workers means one per hardware thread.
+    explicit ThreadPool(unsigned int worker_count = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Pool shared by the loaders.
+    static ThreadPool& shared();
+
+    unsigned int workerCount() const { return static_cast<unsigned int>(workers_.size()); }
+
+    // Runs body(0) ... body(count - 1) on the workers and the calling thread, returns once all calls finished.
+    // The caller works through the indices itself too, so this doesn't deadlock when called from a task of this
+    // pool while every worker is busy. If a call throws, the indices nobody started yet are skipped and the first
+    // exception is rethrown here once every started call has returned.
+    void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+    template <typename F>
+    auto submit(F&& task) -> std::future<decltype(task())>
+    {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            tasks_.emplace_back([packaged]() { (*packaged)(); });
+        }
+        wake_.notify_one();
+        return result;
+    }
+
+private:
+    void workerLoop();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> tasks_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stopping_ = false;
+};
+
+#endif
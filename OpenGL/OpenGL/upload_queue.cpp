@@ -0,0 +1,74 @@
+#include "upload_queue.h"
+
+#include <chrono>
+
+UploadQueue& UploadQueue::main()
+{
+    static UploadQueue queue;
+    return queue;
+}
+
+void UploadQueue::post(std::function<void()> task, size_t bytes, std::string label)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    uploads_.push_back({std::move(task), bytes, std::move(label)});
+}
+
+size_t UploadQueue::process()
+{
+    using Clock = std::chrono::steady_clock;
+    Clock::time_point start = Clock::now();
+    auto elapsed_ms = [start]() {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+
+    FrameStats stats;
+    while (true) {
+        Upload upload;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (uploads_.empty()) {
+                break;
+            }
+            if (stats.tasks > 0) {
+                bool over_bytes = byte_budget_ != 0 && stats.bytes + uploads_.front().bytes > byte_budget_;
+                bool over_time = time_budget_ != 0.0 && elapsed_ms() >= time_budget_;
+                if (over_bytes || over_time) {
+                    break;
+                }
+            }
+            upload = std::move(uploads_.front());
+            uploads_.pop_front();
+        }
+
+        upload.task();
+        ++stats.tasks;
+        stats.bytes += upload.bytes;
+        if (listener_ && !upload.label.empty()) {
+            listener_(upload.label, upload.bytes, frame_);
+        }
+    }
+
+    stats.milliseconds = elapsed_ms();
+    stats.pending = pending();
+    last_frame_ = stats;
+    ++frame_;
+    return stats.tasks;
+}
+
+void UploadQueue::setBudget(size_t bytes_per_frame, double milliseconds_per_frame)
+{
+    byte_budget_ = bytes_per_frame;
+    time_budget_ = milliseconds_per_frame;
+}
+
+void UploadQueue::setResidencyListener(ResidencyListener listener)
+{
+    listener_ = std::move(listener);
+}
+
+size_t UploadQueue::pending()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return uploads_.size();
+}
@@ -0,0 +1,56 @@
+#pragma once
+#ifndef UPLOAD_QUEUE_H
+#define UPLOAD_QUEUE_H
+
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+// GL work posted from loader threads and run by the render loop, the only thread with a current context.
+// process() drains it under a per-frame byte and time budget so a burst of finished loads is spread over several
+// frames instead of landing in one.
+class UploadQueue {
+public:
+    // What the last process() call did.
+    struct FrameStats {
+        size_t tasks = 0;
+        size_t bytes = 0;
+        double milliseconds = 0.0;
+        size_t pending = 0;  // Left for the next frames.
+    };
+    // Called on the GL thread after a labelled upload ran, with the frame number it ran in.
+    using ResidencyListener = std::function<void(const std::string& label, size_t bytes, size_t frame)>;
+
+    // Queue drained by the main render loop.
+    static UploadQueue& main();
+
+    // Any thread. `bytes` is what the task sends to the GPU, tasks with a label are reported once they ran.
+    void post(std::function<void()> task, size_t bytes = 0, std::string label = std::string());
+    // GL thread, once per frame. Runs tasks in order until the next one would go over the byte budget or the time
+    // budget is used up, returns how many ran. At least one task runs per frame so oversized uploads still finish.
+    size_t process();
+
+    // 0 means unlimited, which is the default.
+    void setBudget(size_t bytes_per_frame, double milliseconds_per_frame);
+    void setResidencyListener(ResidencyListener listener);
+    const FrameStats& lastFrame() const { return last_frame_; }
+    size_t pending();
+
+private:
+    struct Upload {
+        std::function<void()> task;
+        size_t bytes;
+        std::string label;
+    };
+
+    std::deque<Upload> uploads_;
+    std::mutex mutex_;
+    size_t byte_budget_ = 0;
+    double time_budget_ = 0.0;
+    ResidencyListener listener_;
+    FrameStats last_frame_;
+    size_t frame_ = 0;
+};
+
+#endif
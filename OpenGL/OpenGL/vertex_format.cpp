@@ -0,0 +1,224 @@
+#include "vertex_format.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <glad/glad.h>
+
+#include "mesh.h"
+
+namespace {
+    int16_t toSnorm16(float value)
+    {
+        return static_cast<int16_t>(std::lround(std::max(-1.0f, std::min(1.0f, value)) * 32767.0f));
+    }
+
+    // GL's snorm16 to float conversion.
+    float fromSnorm16(int16_t value)
+    {
+        return std::max(value / 32767.0f, -1.0f);
+    }
+
+    uint16_t toUnorm16(float value)
+    {
+        return static_cast<uint16_t>(std::lround(std::max(0.0f, std::min(1.0f, value)) * 65535.0f));
+    }
+
+    glm::vec2 signNotZero(const glm::vec2& v)
+    {
+        return glm::vec2(v.x >= 0.0f ? 1.0f : -1.0f, v.y >= 0.0f ? 1.0f : -1.0f);
+    }
+}  // namespace
+
+size_t vertexStride(VertexFormat format)
+{
+    return format == VertexFormat::FLOAT ? sizeof(Vertex) : sizeof(CompactVertex);
+}
+
+const std::vector<VertexAttribute>& vertexAttributes(VertexFormat format)
+{
+    static const std::vector<VertexAttribute> full = {
+        {0, 3, GL_FLOAT, false, offsetof(Vertex, position)},
+        {1, 3, GL_FLOAT, false, offsetof(Vertex, normal)},
+        {2, 2, GL_FLOAT, false, offsetof(Vertex, tex_coords)},
+    };
+    static const std::vector<VertexAttribute> half = {
+        {0, 3, GL_HALF_FLOAT, false, offsetof(CompactVertex, position)},
+        {1, 2, GL_SHORT, true, offsetof(CompactVertex, normal)},
+        {2, 2, GL_HALF_FLOAT, false, offsetof(CompactVertex, tex_coords)},
+    };
+    static const std::vector<VertexAttribute> unorm16 = {
+        {0, 3, GL_UNSIGNED_SHORT, true, offsetof(CompactVertex, position)},
+        {1, 2, GL_SHORT, true, offsetof(CompactVertex, normal)},
+        {2, 2, GL_HALF_FLOAT, false, offsetof(CompactVertex, tex_coords)},
+    };
+    switch (format) {
+    case VertexFormat::HALF:
+        return half;
+    case VertexFormat::UNORM16:
+        return unorm16;
+    default:
+        return full;
+    }
+}
+
+void setupVertexAttributes(VertexFormat format)
+{
+    GLsizei stride = static_cast<GLsizei>(vertexStride(format));
+    for (const VertexAttribute& attribute : vertexAttributes(format)) {
+        glEnableVertexAttribArray(attribute.location);
+        glVertexAttribPointer(attribute.location, attribute.size, attribute.type,
+                              attribute.normalized ? GL_TRUE : GL_FALSE, stride, (void*)attribute.offset);
+    }
+}
+
+QuantizationError quantizeVertices(const Vertex* vertices, size_t vertex_count, VertexFormat format,
+                                   QuantizedVertices& quantized)
+{
+    QuantizationError error;
+    quantized.vertices.resize(vertex_count);
+    if (vertex_count == 0) {
+        return error;
+    }
+
+    glm::vec3 min_position = vertices[0].position;
+    glm::vec3 max_position = vertices[0].position;
+    for (size_t i = 1; i < vertex_count; ++i) {
+        min_position = glm::min(min_position, vertices[i].position);
+        max_position = glm::max(max_position, vertices[i].position);
+    }
+    if (format == VertexFormat::UNORM16) {
+        quantized.position_offset = min_position;
+        quantized.position_scale = max_position - min_position;
+    } else {
+        // Half floats are most precise around 0.
+        quantized.position_offset = (min_position + max_position) * 0.5f;
+        quantized.position_scale = glm::vec3(1.0f);
+    }
+
+    for (size_t i = 0; i < vertex_count; ++i) {
+        const Vertex& source = vertices[i];
+        CompactVertex& target = quantized.vertices[i];
+
+        glm::vec3 decoded_position;
+        for (int axis = 0; axis < 3; ++axis) {
+            float local = source.position[axis] - quantized.position_offset[axis];
+            float scale = quantized.position_scale[axis];
+            if (format == VertexFormat::UNORM16) {
+                target.position[axis] = toUnorm16(scale > 0.0f ? local / scale : 0.0f);
+                decoded_position[axis] = quantized.position_offset[axis] + target.position[axis] / 65535.0f * scale;
+            } else {
+                target.position[axis] = floatToHalf(local);
+                decoded_position[axis] = quantized.position_offset[axis] + halfToFloat(target.position[axis]);
+            }
+        }
+        target.position[3] = 0;
+
+        glm::vec2 encoded = octahedralEncode(source.normal);
+        target.normal[0] = toSnorm16(encoded.x);
+        target.normal[1] = toSnorm16(encoded.y);
+        glm::vec3 decoded_normal =
+            octahedralDecode(glm::vec2(fromSnorm16(target.normal[0]), fromSnorm16(target.normal[1])));
+
+        target.tex_coords[0] = floatToHalf(source.tex_coords.x);
+        target.tex_coords[1] = floatToHalf(source.tex_coords.y);
+        glm::vec2 decoded_tex_coords(halfToFloat(target.tex_coords[0]), halfToFloat(target.tex_coords[1]));
+
+        error.position = std::max(error.position, glm::length(decoded_position - source.position));
+        float normal_length = glm::length(source.normal);
+        if (normal_length > 0.0f) {
+            float cosine = glm::dot(decoded_normal, source.normal / normal_length);
+            float degrees = glm::degrees(std::acos(std::max(-1.0f, std::min(1.0f, cosine))));
+            error.normal_degrees = std::max(error.normal_degrees, degrees);
+        }
+        error.tex_coords = std::max(error.tex_coords, glm::length(decoded_tex_coords - source.tex_coords));
+    }
+    return error;
+}
+
+uint16_t floatToHalf(float value)
+{
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    uint32_t sign = (bits >> 16) & 0x8000;
+    int32_t exponent = int32_t((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    // Inf and NaN.
+    if (((bits >> 23) & 0xff) == 0xff) {
+        return static_cast<uint16_t>(sign | 0x7c00 | (mantissa != 0 ? 0x200 : 0));
+    }
+    // Too large, saturate to infinity.
+    if (exponent >= 31) {
+        return static_cast<uint16_t>(sign | 0x7c00);
+    }
+    // Denormal or zero.
+    if (exponent <= 0) {
+        if (exponent < -10) {
+            return static_cast<uint16_t>(sign);
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = static_cast<uint32_t>(14 - exponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            ++half;
+        }
+        return static_cast<uint16_t>(sign | half);
+    }
+
+    // Round to nearest even, a carry out of the mantissa correctly bumps the exponent.
+    uint32_t half = sign | (uint32_t(exponent) << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        ++half;
+    }
+    return static_cast<uint16_t>(half);
+}
+
+float halfToFloat(uint16_t value)
+{
+    uint32_t sign = uint32_t(value & 0x8000) << 16;
+    uint32_t exponent = (value >> 10) & 0x1f;
+    uint32_t mantissa = value & 0x3ff;
+    uint32_t bits;
+    if (exponent == 0) {
+        // Zero or denormal, 2^-24 per step.
+        float magnitude = std::ldexp(float(mantissa), -24);
+        return sign != 0 ? -magnitude : magnitude;
+    } else if (exponent == 31) {
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    } else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    float result;
+    std::memcpy(&result, &bits, sizeof(result));
+    return result;
+}
+
+glm::vec2 octahedralEncode(const glm::vec3& normal)
+{
+    float l1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (l1 == 0.0f) {
+        return glm::vec2(0.0f);
+    }
+    glm::vec3 n = normal / l1;
+    glm::vec2 encoded(n.x, n.y);
+    // Fold the lower hemisphere over the diagonals.
+    if (n.z < 0.0f) {
+        encoded = (1.0f - glm::abs(glm::vec2(encoded.y, encoded.x))) * signNotZero(encoded);
+    }
+    return encoded;
+}
+
+glm::vec3 octahedralDecode(const glm::vec2& encoded)
+{
+    glm::vec3 n(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+    if (n.z < 0.0f) {
+        glm::vec2 folded = (1.0f - glm::abs(glm::vec2(n.y, n.x))) * signNotZero(glm::vec2(n.x, n.y));
+        n.x = folded.x;
+        n.y = folded.y;
+    }
+    return glm::normalize(n);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <glm.hpp>
+
+struct Vertex;
+
+// Layout of the vertices a Mesh uploads. The compact formats take 16 bytes instead of 32:
+//   HALF     position as half floats relative to the bounding box centre,
+//   UNORM16  position as unorm16 across the bounding box,
+// both with an octahedral normal in 2 x snorm16 and half float texture coordinates.
+// Shaders undo the position mapping with the positionOffset/positionScale uniforms and decode the normal when
+// octahedralNormals is set, see model/model.vs.
+enum class VertexFormat {
+    FLOAT,
+    HALF,
+    UNORM16,
+};
+
+struct CompactVertex {
+    uint16_t position[4];  // xyz, w is padding.
+    int16_t normal[2];
+    uint16_t tex_coords[2];
+};
+
+struct VertexAttribute {
+    unsigned int location;
+    int size;
+    unsigned int type;
+    bool normalized;
+    size_t offset;
+};
+
+// A mesh's vertices in a compact format plus what the shader needs to decode them.
+struct QuantizedVertices {
+    std::vector<CompactVertex> vertices;
+    glm::vec3 position_offset = glm::vec3(0.0f);
+    glm::vec3 position_scale = glm::vec3(1.0f);
+};
+
+// Largest difference between the source vertices and what the shader will decode.
+struct QuantizationError {
+    float position = 0.0f;       // In model units.
+    float normal_degrees = 0.0f;
+    float tex_coords = 0.0f;
+};
+
+size_t vertexStride(VertexFormat format);
+const std::vector<VertexAttribute>& vertexAttributes(VertexFormat format);
+// Enables and points the attributes of the format at the bound GL_ARRAY_BUFFER, for the bound VAO.
+void setupVertexAttributes(VertexFormat format);
+
+// `format` must be one of the compact ones.
+QuantizationError quantizeVertices(const Vertex* vertices, size_t vertex_count, VertexFormat format,
+                                   QuantizedVertices& quantized);
+
+uint16_t floatToHalf(float value);
+float halfToFloat(uint16_t value);
+glm::vec2 octahedralEncode(const glm::vec3& normal);
+glm::vec3 octahedralDecode(const glm::vec2& encoded);
+
+#endif